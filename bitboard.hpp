@@ -0,0 +1,243 @@
+#ifndef SUDOKU_BITBOARD
+#define SUDOKU_BITBOARD
+
+#include "fastgrid.hpp"
+#include "output.hpp"
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+ * Fixed-size set of bits stored as 64-bit words, with the whole-board
+ * operations BitboardSolver needs and a scan for the next set bit. Uses the
+ * same compiler builtins as CandidateSet, so it builds wherever that does.
+ */
+template<size_t num_bits>
+class Bitboard{
+public:
+    Bitboard() : words_() {}
+    //sets every bit
+    void set(){
+        words_.fill(~0ULL);
+        trim_();
+    }
+    void set(size_t i){words_[i/64] |= 1ULL << (i%64);}
+    void reset(size_t i){words_[i/64] &= ~(1ULL << (i%64));}
+    bool test(size_t i) const{return (words_[i/64] >> (i%64)) & 1;}
+    bool any() const{
+        for(auto word : words_){
+            if(word) return true;
+        }
+        return false;
+    }
+    bool all() const{return !(~*this).any();}
+    size_t count() const{
+        size_t total = 0;
+        for(auto word : words_) total += __builtin_popcountll(word);
+        return total;
+    }
+    //first set bit at or after i, or num_bits if there is none
+    size_t find(size_t i=0) const{
+        for(size_t k=i/64; k<num_words; ++k){
+            unsigned long long word = words_[k];
+            if(k==i/64) word &= ~0ULL << (i%64);
+            if(word) return 64*k + __builtin_ctzll(word);
+        }
+        return num_bits;
+    }
+    Bitboard& operator&=(const Bitboard& o){
+        for(size_t k=0; k<num_words; ++k) words_[k] &= o.words_[k];
+        return *this;
+    }
+    Bitboard& operator|=(const Bitboard& o){
+        for(size_t k=0; k<num_words; ++k) words_[k] |= o.words_[k];
+        return *this;
+    }
+    Bitboard operator~() const{
+        Bitboard result;
+        for(size_t k=0; k<num_words; ++k) result.words_[k] = ~words_[k];
+        result.trim_();
+        return result;
+    }
+    friend Bitboard operator&(Bitboard a, const Bitboard& b){return a &= b;}
+    friend Bitboard operator|(Bitboard a, const Bitboard& b){return a |= b;}
+private:
+    static const size_t num_words = (num_bits+63)/64;
+    std::array<unsigned long long, num_words> words_;
+    //clears the unused bits of the last word
+    void trim_(){
+        if(num_bits%64) words_[num_words-1] &= (1ULL << (num_bits%64)) - 1;
+    }
+};
+
+/*
+ * Solver engine that stores candidates as one bitboard per value, each with
+ * a bit per cell, instead of a candidate set per cell. Row, column, box and
+ * peer masks are precomputed, so placing a value, clearing it from peers,
+ * and finding naked and hidden singles are whole-board AND/OR/popcount
+ * operations: a 16x16 board is four 64-bit words, a 25x25 one ten.
+ *
+ * Same interface as Solver, minus the verbose trace and the transposition
+ * table. For puzzles with more than one solution the two engines may find
+ * different ones.
+ */
+template<size_t side_length, size_t box_height, size_t box_width>
+class BitboardSolver{
+public:
+    typedef FastGrid<side_length, box_height, box_width> GridType;
+    typedef Bitboard<side_length*side_length> Board;
+    BitboardSolver(const GridType& g,
+            std::array<char, side_length> allowed_vals) :
+        grid_(g), allowed_vals_(allowed_vals){
+        for(auto& board : candidates_) board.set();
+        for(size_t r=0; r<side_length; ++r){
+            for(size_t c=0; c<side_length; ++c){
+                char val = grid_.at(r,c);
+                if(val=='.') continue;
+                auto it = std::find(allowed_vals_.begin(),
+                        allowed_vals_.end(), val);
+                if(it==allowed_vals_.end()){
+                    throw(std::invalid_argument(
+                                std::string("Invalid cell value: ") + val));
+                }
+                place_(r*side_length + c, it - allowed_vals_.begin());
+            }
+        }
+    }
+    void solve(){
+        if(!search_()) throw(std::runtime_error("No solutions."));
+    }
+    const GridType& grid() const{return grid_;}
+    const Stats& stats() const{return stats_;}
+private:
+    static const size_t num_cells = side_length*side_length;
+    struct Masks{
+        std::array<Board, 3*side_length> groups; //rows, cols, boxes
+        std::array<Board, num_cells> peers;
+    };
+    GridType grid_;
+    std::array<char, side_length> allowed_vals_;
+    std::array<Board, side_length> candidates_; //cells where each val fits
+    std::array<Board, side_length> placed_; //cells holding each val
+    Board filled_;
+    Stats stats_;
+    static const Masks& masks_(){
+        static const Masks masks = [](){
+            Masks m;
+            size_t boxes_per_row = side_length/box_width;
+            for(size_t r=0; r<side_length; ++r){
+                for(size_t c=0; c<side_length; ++c){
+                    size_t b = (r/box_height)*boxes_per_row + c/box_width;
+                    m.groups[r].set(r*side_length + c);
+                    m.groups[side_length + c].set(r*side_length + c);
+                    m.groups[2*side_length + b].set(r*side_length + c);
+                }
+            }
+            for(size_t cell=0; cell<num_cells; ++cell){
+                size_t r = cell/side_length, c = cell%side_length;
+                size_t b = (r/box_height)*boxes_per_row + c/box_width;
+                m.peers[cell] = m.groups[r] | m.groups[side_length + c]
+                    | m.groups[2*side_length + b];
+            }
+            return m;
+        }();
+        return masks;
+    }
+    void place_(size_t cell, size_t val){
+        for(auto& board : candidates_) board.reset(cell);
+        candidates_[val] &= ~masks_().peers[cell];
+        placed_[val].set(cell);
+        filled_.set(cell);
+        grid_.set(cell/side_length, cell%side_length, allowed_vals_[val]);
+    }
+    //Places naked and hidden singles until there are none left. Returns
+    //false on a contradiction.
+    bool propagate_(){
+        const auto& masks = masks_();
+        bool changed = true;
+        while(changed){
+            changed = false;
+            //cells with at least one, and at least two, candidates
+            Board ones, twos;
+            for(const auto& board : candidates_){
+                twos |= ones & board;
+                ones |= board;
+            }
+            if((~filled_ & ~ones).any()) return false; //cell with no options
+            Board singles = ones & ~twos;
+            for(size_t val=0; val<side_length && singles.any(); ++val){
+                Board found = singles & candidates_[val];
+                for(size_t cell=found.find(); cell<num_cells;
+                        cell=found.find(cell+1)){
+                    //an earlier placement may have taken the last option
+                    if(!candidates_[val].test(cell)) return false;
+                    place_(cell, val);
+                    changed = true;
+                }
+                singles &= ~found;
+            }
+            if(changed) continue; //naked singles are cheaper, so redo them
+            //vals that fit in only one cell of a group
+            for(size_t val=0; val<side_length; ++val){
+                for(const auto& group : masks.groups){
+                    if((placed_[val] & group).any()) continue;
+                    Board spots = candidates_[val] & group;
+                    size_t count = spots.count();
+                    if(count==0) return false;
+                    if(count==1){
+                        place_(spots.find(), val);
+                        changed = true;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+    size_t branch_cell_() const{
+        //fewest candidates, preferring any cell with exactly two
+        Board ones, twos, threes;
+        for(const auto& board : candidates_){
+            threes |= twos & board;
+            twos |= ones & board;
+            ones |= board;
+        }
+        Board pairs = twos & ~threes;
+        if(pairs.any()) return pairs.find();
+        size_t best = 0, best_count = side_length+1;
+        Board empty = ~filled_;
+        for(size_t cell=empty.find(); cell<num_cells;
+                cell=empty.find(cell+1)){
+            size_t count = 0;
+            for(const auto& board : candidates_) count += board.test(cell);
+            if(count < best_count){
+                best = cell;
+                best_count = count;
+            }
+        }
+        return best;
+    }
+    bool search_(){
+        if(!propagate_()) return false;
+        if(filled_.all()) return true;
+        size_t cell = branch_cell_();
+        //save current state
+        auto current_candidates = candidates_;
+        auto current_placed = placed_;
+        auto current_filled = filled_;
+        auto current_grid = grid_;
+        for(size_t val=0; val<side_length; ++val){
+            if(!current_candidates[val].test(cell)) continue;
+            ++stats_.guesses;
+            place_(cell, val);
+            if(search_()) return true;
+            ++stats_.contradictions;
+            candidates_ = current_candidates;
+            placed_ = current_placed;
+            filled_ = current_filled;
+            grid_ = current_grid;
+        }
+        return false;
+    }
+};
+
+#endif
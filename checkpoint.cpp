@@ -0,0 +1,82 @@
+#include "checkpoint.hpp"
+#include "corpus.hpp"
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdexcept>
+
+namespace{
+
+const char magic[4] = {'S','D','K','C'};
+const unsigned char version = 1;
+
+void write_record(std::ostream& os, const std::vector<char>& cells,
+        size_t side_length){
+    auto record = encode_record(cells, side_length);
+    os.put(char(record.size() & 0xFF));
+    os.put(char(record.size() >> 8));
+    os.write(reinterpret_cast<const char*>(record.data()), record.size());
+}
+
+std::vector<char> read_record(std::istream& is, size_t side_length){
+    unsigned char len[2];
+    if(!is.read(reinterpret_cast<char*>(len), 2)){
+        throw(std::runtime_error("Truncated file"));
+    }
+    std::vector<unsigned char> record(len[0] | (len[1] << 8));
+    if(!is.read(reinterpret_cast<char*>(record.data()), record.size())){
+        throw(std::runtime_error("Truncated file"));
+    }
+    return decode_record(record, side_length);
+}
+
+}
+
+void Checkpoint::write(const std::string& filename) const{
+    write_atomically(filename, [this](const std::string& partial){
+        std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+        if(!file){ throw(std::runtime_error("Invalid file " + partial)); }
+        file.write(magic, 4);
+        file.put(char(version));
+        file.put(char(shape.side_length));
+        file.put(char(shape.box_height));
+        file.put(char(shape.box_width));
+        write_u64(file, solutions);
+        write_u64(file, nodes);
+        write_u64(file, frontier.size());
+        write_record(file, puzzle, shape.side_length);
+        for(const auto& cells : frontier){
+            write_record(file, cells, shape.side_length);
+        }
+        file.close();
+        if(file.fail()){
+            throw(std::runtime_error("Failed to write " + partial));
+        }
+    });
+}
+
+Checkpoint Checkpoint::read(const std::string& filename){
+    std::ifstream file(filename, std::ios::binary);
+    if(!file){ throw(std::invalid_argument("Invalid file")); }
+    char buf[8];
+    if(!file.read(buf, 8) || !std::equal(buf, buf+4, magic)){
+        throw(std::invalid_argument("Not a checkpoint file"));
+    }
+    if((unsigned char)buf[4]!=version){
+        throw(std::invalid_argument("Unsupported checkpoint version"));
+    }
+    Checkpoint checkpoint;
+    checkpoint.shape = {(unsigned char)buf[5], (unsigned char)buf[6],
+        (unsigned char)buf[7]};
+    checkpoint.solutions = read_u64(file);
+    checkpoint.nodes = read_u64(file);
+    std::uint64_t size = read_u64(file);
+    size_t side_length = checkpoint.shape.side_length;
+    checkpoint.puzzle = read_record(file, side_length);
+    for(std::uint64_t i=0; i<size; ++i){
+        checkpoint.frontier.push_back(read_record(file, side_length));
+    }
+    return checkpoint;
+}
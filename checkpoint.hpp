@@ -0,0 +1,40 @@
+#ifndef SUDOKU_CHECKPOINT
+#define SUDOKU_CHECKPOINT
+#include "corpus.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/*
+ * Saved state of an exhaustive search.
+ *
+ * Layout (all integers little endian):
+ *   0   "SDKC" magic
+ *   4   u8  format version
+ *   5   u8  side length
+ *   6   u8  box height
+ *   7   u8  box width
+ *   8   u64 solutions found so far
+ *   16  u64 nodes searched so far
+ *   24  u64 frontier size
+ *   32  the puzzle being searched, as a u16 length and a corpus record
+ *   ... frontier entries, in the same form
+ *
+ * The frontier holds the subproblems still to be searched, as grids with
+ * their branch placement already made. Candidates are not stored: they
+ * follow from the grid, so each entry is just its packed givens. Entries
+ * are in stack order, the next one to search last.
+ */
+struct Checkpoint{
+    Shape shape;
+    std::uint64_t solutions;
+    std::uint64_t nodes;
+    std::vector<char> puzzle;
+    std::vector<std::vector<char>> frontier;
+    //writes to a temporary file that then replaces filename, so a reader
+    //always sees either the old checkpoint or the new one
+    void write(const std::string& filename) const;
+    static Checkpoint read(const std::string& filename);
+};
+
+#endif
@@ -0,0 +1,301 @@
+#include "corpus.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+
+namespace{
+
+const char magic[4] = {'S','D','K','B'};
+const unsigned char version = 3;
+const std::uint64_t header_size = 76;
+
+//FNV-1a
+const std::uint64_t checksum_basis = 0xCBF29CE484222325ULL;
+std::uint64_t add_checksum(std::uint64_t checksum, const unsigned char* data,
+        size_t size){
+    for(size_t i=0; i<size; ++i){
+        checksum = (checksum ^ data[i])*0x100000001B3ULL;
+    }
+    return checksum;
+}
+
+void write_u32(std::ostream& os, std::uint32_t val){
+    for(size_t i=0; i<4; ++i) os.put(char((val >> (8*i)) & 0xFF));
+}
+
+std::uint32_t read_u32(std::istream& is){
+    unsigned char bytes[4];
+    if(!is.read(reinterpret_cast<char*>(bytes), 4)){
+        throw(std::runtime_error("Truncated file"));
+    }
+    std::uint32_t val = 0;
+    for(size_t i=0; i<4; ++i) val |= std::uint32_t(bytes[i]) << (8*i);
+    return val;
+}
+
+size_t bits_per_value(size_t side_length){
+    size_t bits = 1;
+    while((size_t(1) << bits) < side_length) ++bits;
+    return bits;
+}
+
+//Decodes a record into cells, which must already hold side_length^2
+//cells. syms is symbols(side_length), passed in so that readers can
+//look it up once.
+void decode(const unsigned char* record, size_t size, size_t side_length,
+        const std::vector<char>& syms, std::vector<char>& cells){
+    size_t num_cells = side_length*side_length;
+    size_t bits = bits_per_value(side_length);
+    size_t mask = (size_t(1) << bits) - 1;
+    size_t bitmap_bytes = (num_cells+7)/8;
+    if(size < bitmap_bytes){
+        throw(std::runtime_error("Truncated corpus record"));
+    }
+    size_t num_givens = 0;
+    for(size_t i=0; i<bitmap_bytes; ++i){
+        num_givens += __builtin_popcount(record[i]);
+    }
+    if(size < bitmap_bytes + (num_givens*bits + 7)/8){
+        throw(std::runtime_error("Truncated corpus record"));
+    }
+    std::fill(cells.begin(), cells.end(), '.');
+    size_t bit_pos = 8*bitmap_bytes;
+    for(size_t i=0; i<num_cells; ++i){
+        if(!(record[i/8] & (1 << (i%8)))) continue;
+        //a value spans at most two bytes, the second maybe past the end
+        size_t byte = bit_pos/8;
+        size_t window = record[byte];
+        if(byte+1 < size) window |= size_t(record[byte+1]) << 8;
+        size_t val = (window >> (bit_pos%8)) & mask;
+        bit_pos += bits;
+        if(val >= side_length){
+            throw(std::runtime_error("Corrupt corpus record"));
+        }
+        cells[i] = syms[val];
+    }
+}
+
+}
+
+void write_atomically(const std::string& filename,
+        const std::function<void(const std::string&)>& write){
+    std::string partial = filename + ".partial";
+    try{
+        write(partial);
+    }
+    catch(...){
+        std::remove(partial.c_str());
+        throw;
+    }
+    if(std::rename(partial.c_str(), filename.c_str())){
+        std::remove(partial.c_str());
+        throw(std::runtime_error("Failed to write " + filename));
+    }
+}
+
+void write_u64(std::ostream& os, std::uint64_t val){
+    for(size_t i=0; i<8; ++i) os.put(char((val >> (8*i)) & 0xFF));
+}
+
+std::uint64_t read_u64(std::istream& is){
+    unsigned char bytes[8];
+    if(!is.read(reinterpret_cast<char*>(bytes), 8)){
+        throw(std::runtime_error("Truncated file"));
+    }
+    std::uint64_t val = 0;
+    for(size_t i=0; i<8; ++i) val |= std::uint64_t(bytes[i]) << (8*i);
+    return val;
+}
+
+Shape shape_for(size_t side_length){
+    switch(side_length){
+        case 4:  return {4, 2, 2};
+        case 6:  return {6, 2, 3};
+        case 9:  return {9, 3, 3};
+        case 16: return {16, 4, 4};
+        default: throw(std::length_error("Unknown puzzle size"));
+    }
+}
+
+std::vector<char> symbols(size_t side_length){
+    std::string all = "1234567890ABCDEF";
+    if(side_length==16) return std::vector<char>(all.begin(), all.end());
+    shape_for(side_length); //throws on unsupported sizes
+    return std::vector<char>(all.begin(), all.begin() + side_length);
+}
+
+std::vector<unsigned char> encode_record(const std::vector<char>& cells,
+        size_t side_length){
+    size_t num_cells = side_length*side_length;
+    if(cells.size()!=num_cells){
+        throw(std::length_error("Record does not match corpus size"));
+    }
+    auto syms = symbols(side_length);
+    size_t bits = bits_per_value(side_length);
+    size_t bitmap_bytes = (num_cells+7)/8;
+    std::vector<unsigned char> record(bitmap_bytes);
+    //givens bitmap, then packed values of the givens
+    size_t bit_pos = 0;
+    for(size_t i=0; i<num_cells; ++i){
+        if(cells[i]=='.') continue;
+        auto it = std::find(syms.begin(), syms.end(), cells[i]);
+        if(it==syms.end()){
+            throw(std::invalid_argument(
+                        std::string("Invalid cell value: ") + cells[i]));
+        }
+        record[i/8] |= 1 << (i%8);
+        size_t val = it - syms.begin();
+        for(size_t b=0; b<bits; ++b, ++bit_pos){
+            if(bit_pos%8==0) record.push_back(0);
+            if(val & (size_t(1) << b)){
+                record.back() |= 1 << (bit_pos%8);
+            }
+        }
+    }
+    return record;
+}
+
+std::vector<char> decode_record(const std::vector<unsigned char>& record,
+        size_t side_length){
+    std::vector<char> cells(side_length*side_length);
+    decode(record.data(), record.size(), side_length, symbols(side_length),
+            cells);
+    return cells;
+}
+
+bool is_corpus(const std::string& filename){
+    std::ifstream file(filename, std::ios::binary);
+    char buf[4];
+    return file.read(buf, 4) && std::equal(buf, buf+4, magic);
+}
+
+std::uint64_t shard_size(std::uint64_t size, size_t shard,
+        size_t num_shards){
+    return shard < size ? (size - shard + num_shards - 1)/num_shards : 0;
+}
+
+/*
+ * CorpusWriter Functions
+ */
+
+CorpusWriter::CorpusWriter(const std::string& filename, const Shape& shape,
+        const Source& source) :
+    file_(filename, std::ios::binary | std::ios::trunc), shape_(shape),
+    checksum_(checksum_basis){
+    if(!file_){ throw(std::invalid_argument("Invalid file")); }
+    shape_for(shape_.side_length); //throws on unsupported sizes
+    offsets_.push_back(0);
+    //header, patched with the real count, index position, checksum and
+    //totals on close()
+    file_.write(magic, 4);
+    file_.put(char(version));
+    file_.put(char(shape_.side_length));
+    file_.put(char(shape_.box_height));
+    file_.put(char(shape_.box_width));
+    write_u64(file_, 0);
+    write_u64(file_, 0);
+    write_u64(file_, 0);
+    write_u64(file_, source.checksum);
+    write_u64(file_, source.size);
+    write_u32(file_, source.shard);
+    write_u32(file_, source.num_shards);
+    write_u32(file_, std::uint32_t(source.mode));
+    write_u64(file_, 0);
+    write_u64(file_, 0);
+}
+
+void CorpusWriter::add(const std::vector<char>& cells){
+    auto record = encode_record(cells, shape_.side_length);
+    file_.write(reinterpret_cast<const char*>(record.data()), record.size());
+    offsets_.push_back(offsets_.back() + record.size());
+    checksum_ = add_checksum(checksum_, record.data(), record.size());
+}
+
+void CorpusWriter::close(std::uint64_t solved, std::uint64_t failed){
+    std::uint64_t index_start = header_size + offsets_.back();
+    for(auto offset : offsets_) write_u64(file_, offset);
+    file_.seekp(8);
+    write_u64(file_, size());
+    write_u64(file_, index_start);
+    write_u64(file_, checksum_);
+    file_.seekp(60);
+    write_u64(file_, solved);
+    write_u64(file_, failed);
+    file_.close();
+    if(file_.fail()){ throw(std::runtime_error("Failed to write corpus")); }
+}
+
+/*
+ * CorpusReader Functions
+ */
+
+CorpusReader::CorpusReader(const std::string& filename) :
+    file_(filename, std::ios::binary){
+    if(!file_){ throw(std::invalid_argument("Invalid file")); }
+    char buf[8];
+    if(!file_.read(buf, 8) || !std::equal(buf, buf+4, magic)){
+        throw(std::invalid_argument("Not a corpus file"));
+    }
+    if((unsigned char)buf[4]!=version){
+        throw(std::invalid_argument("Unsupported corpus version"));
+    }
+    shape_ = {(unsigned char)buf[5], (unsigned char)buf[6],
+        (unsigned char)buf[7]};
+    shape_for(shape_.side_length); //throws on unsupported sizes
+    size_ = read_u64(file_);
+    index_start_ = read_u64(file_);
+    checksum_ = read_u64(file_);
+    source_.checksum = read_u64(file_);
+    source_.size = read_u64(file_);
+    source_.shard = read_u32(file_);
+    source_.num_shards = read_u32(file_);
+    std::uint32_t mode = read_u32(file_);
+    if(mode > std::uint32_t(Mode::edit)){
+        throw(std::runtime_error("Unknown corpus mode"));
+    }
+    source_.mode = Mode(mode);
+    source_.solved = read_u64(file_);
+    source_.failed = read_u64(file_);
+    //a writer that never reached close() leaves the index position unset
+    if(index_start_ < header_size){
+        throw(std::runtime_error("Incomplete corpus file"));
+    }
+    //the whole index is read up front, so that fetching a record is a
+    //single read, and no seek at all when records are read in order
+    file_.seekg(index_start_);
+    offsets_.resize(size_+1);
+    for(auto& offset : offsets_){
+        offset = read_u64(file_);
+        if(offset < offsets_.front() || offset > index_start_ - header_size){
+            throw(std::runtime_error("Corrupt corpus index"));
+        }
+    }
+    symbols_ = symbols(shape_.side_length);
+    position_ = index_start_ + 8*(size_+1);
+}
+
+std::vector<char> CorpusReader::at(size_t i){
+    std::vector<char> cells(shape_.side_length*shape_.side_length);
+    at(i, cells);
+    return cells;
+}
+
+void CorpusReader::at(size_t i, std::vector<char>& cells){
+    if(i >= size_){ throw(std::out_of_range("Corpus index out of range")); }
+    std::uint64_t begin = header_size + offsets_[i];
+    std::uint64_t end = header_size + offsets_[i+1];
+    if(end < begin){ throw(std::runtime_error("Corrupt corpus index")); }
+    //seeking discards the stream's buffer, so only seek when needed
+    if(position_!=begin) file_.seekg(begin);
+    record_.resize(end - begin);
+    if(!file_.read(reinterpret_cast<char*>(record_.data()), record_.size())){
+        throw(std::runtime_error("Truncated corpus file"));
+    }
+    position_ = end;
+    cells.resize(shape_.side_length*shape_.side_length);
+    decode(record_.data(), record_.size(), shape_.side_length, symbols_,
+            cells);
+}
@@ -0,0 +1,136 @@
+#ifndef SUDOKU_CORPUS
+#define SUDOKU_CORPUS
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+#include <stdexcept>
+
+/*
+ * Packed binary puzzle corpus.
+ *
+ * Layout (all integers little endian):
+ *   0   "SDKB" magic
+ *   4   u8  format version
+ *   5   u8  side length
+ *   6   u8  box height
+ *   7   u8  box width
+ *   8   u64 record count
+ *   16  u64 file position of the offset index
+ *   24  u64 checksum of the record data
+ *   32  u64 checksum of the source corpus (0 if none)
+ *   40  u64 record count of the source corpus
+ *   48  u32 shard index
+ *   52  u32 shard count
+ *   56  u32 mode (0 if none)
+ *   60  u64 records solved
+ *   68  u64 records failed
+ *   76  record data
+ *   ... u64 offsets[count+1], relative to the start of the record data
+ *
+ * Each record is a givens bitmap (one bit per cell, row major) followed by
+ * the values of the given cells only, packed at the fewest bits that can
+ * hold an index into symbols(side_length). Record i is the byte range
+ * [offsets[i], offsets[i+1]), so any record can be fetched with two seeks.
+ * The index goes last so that a writer can stream records straight to disk.
+ *
+ * The source fields say where the records came from and what was done to
+ * them, so that the outputs of fastsolve --shard can be checked against
+ * their input and each other, and their stats totalled without rerunning.
+ */
+
+struct Shape{
+    size_t side_length;
+    size_t box_height;
+    size_t box_width;
+};
+
+//box shape used for each supported side length
+Shape shape_for(size_t side_length);
+
+//cell symbols for a side length, in the order the solvers use
+std::vector<char> symbols(size_t side_length);
+
+std::vector<unsigned char> encode_record(const std::vector<char>& cells,
+        size_t side_length);
+std::vector<char> decode_record(const std::vector<unsigned char>& record,
+        size_t side_length);
+
+bool is_corpus(const std::string& filename);
+
+//what fastsolve did to a corpus's records; none for a corpus it did not
+//write
+enum class Mode{none, solve, minimize, count, edit};
+
+//Corpus that a corpus's records were derived from: record k is record
+//shard + k*num_shards of the source, after mode was applied to it. solved
+//and failed count the records that mode succeeded and failed on.
+struct Source{
+    std::uint64_t checksum = 0;
+    std::uint64_t size = 0;
+    size_t shard = 0;
+    size_t num_shards = 1;
+    Mode mode = Mode::none;
+    std::uint64_t solved = 0;
+    std::uint64_t failed = 0;
+};
+
+//number of records of a size record corpus that go to a shard
+std::uint64_t shard_size(std::uint64_t size, size_t shard, size_t num_shards);
+
+//Calls write with the name of a temporary file next to filename, then
+//renames that file to filename. If write throws, the temporary file is
+//removed and the exception passed on, so filename is only ever replaced
+//by a complete file.
+void write_atomically(const std::string& filename,
+        const std::function<void(const std::string&)>& write);
+
+//little endian integers, as used in corpus and checkpoint headers
+void write_u64(std::ostream& os, std::uint64_t val);
+std::uint64_t read_u64(std::istream& is);
+
+//Streams records into a corpus file. Only close() finishes the file: one
+//abandoned without it (e.g. by an exception) keeps its unset index
+//position, so CorpusReader rejects it as incomplete.
+class CorpusWriter{
+public:
+    CorpusWriter(const std::string& filename, const Shape& shape,
+            const Source& source=Source());
+    void add(const std::vector<char>& cells);
+    //solved and failed replace those of the source passed in
+    void close(std::uint64_t solved=0, std::uint64_t failed=0);
+    size_t size() const {return offsets_.size()-1;}
+    const Shape& shape() const {return shape_;}
+private:
+    std::ofstream file_;
+    Shape shape_;
+    std::vector<std::uint64_t> offsets_;
+    std::uint64_t checksum_;
+};
+
+class CorpusReader{
+public:
+    CorpusReader(const std::string& filename);
+    std::vector<char> at(size_t i);
+    //the same, reusing cells' storage; reading in order is fastest
+    void at(size_t i, std::vector<char>& cells);
+    size_t size() const {return size_;}
+    const Shape& shape() const {return shape_;}
+    std::uint64_t checksum() const {return checksum_;}
+    const Source& source() const {return source_;}
+private:
+    std::ifstream file_;
+    Shape shape_;
+    size_t size_;
+    std::uint64_t checksum_;
+    Source source_;
+    std::uint64_t index_start_;
+    std::vector<std::uint64_t> offsets_;
+    std::vector<char> symbols_;
+    std::vector<unsigned char> record_;
+    std::uint64_t position_; //of the stream, so reads in order never seek
+};
+
+#endif
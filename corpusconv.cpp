@@ -0,0 +1,131 @@
+#include "corpus.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+using namespace std;
+
+const std::string usage = "Usage: corpusconv pack [output] [input ...]\n"
+    "       corpusconv unpack [input] [output]";
+
+//Side length of the puzzles in a file whose first non-empty line has
+//line_cells cells: either one row of a grid (as in examples/), or a whole
+//grid on one line. 16 cells could be a whole 4x4 grid or a row of a 16x16
+//one; only the latter can use symbols past 4.
+size_t side_from_line(size_t line_cells, const std::vector<char>& cells){
+    if(line_cells==16){
+        auto small = symbols(4);
+        bool fits_4x4 = std::all_of(cells.begin(), cells.end(), [&](char c){
+                    return c=='.'
+                        || std::find(small.begin(), small.end(), c)!=small.end();
+                });
+        return fits_4x4 ? 4 : 16;
+    }
+    for(size_t side : {4, 6, 9, 16}){
+        if(line_cells==side || line_cells==side*side) return side;
+    }
+    return 0;
+}
+
+//Reads every puzzle in a text file.
+std::vector<std::vector<char>> read_text(std::string filename){
+    std::ifstream file(filename);
+    if(!file){ throw(invalid_argument("Invalid file " + filename)); }
+    std::vector<char> cells;
+    size_t first_line_cells = 0;
+    std::string line;
+    while(std::getline(file, line)){
+        size_t line_cells = 0;
+        for(char c : line){
+            if(c=='.' || isalnum(c)){
+                cells.push_back(c);
+                ++line_cells;
+            }
+        }
+        if(!first_line_cells) first_line_cells = line_cells;
+    }
+    size_t side_length = side_from_line(first_line_cells, cells);
+    if(first_line_cells && !side_length){
+        throw(invalid_argument("Unrecognized puzzle size in " + filename));
+    }
+    size_t num_cells = side_length*side_length;
+    if(!num_cells || cells.size()%num_cells){
+        throw(invalid_argument("Incomplete puzzle in " + filename));
+    }
+    std::vector<std::vector<char>> puzzles;
+    for(auto it=cells.begin(); it!=cells.end(); it+=num_cells){
+        puzzles.emplace_back(it, it+num_cells);
+    }
+    return puzzles;
+}
+
+void pack(std::string output, std::vector<std::string> inputs){
+    size_t packed = 0;
+    write_atomically(output, [&](const std::string& partial){
+        std::unique_ptr<CorpusWriter> writer;
+        for(auto input : inputs){
+            for(auto puzzle : read_text(input)){
+                size_t side_length = 0;
+                while(side_length*side_length < puzzle.size()) ++side_length;
+                if(!writer){
+                    writer.reset(new CorpusWriter(partial,
+                                shape_for(side_length)));
+                }
+                else if(writer->shape().side_length!=side_length){
+                    throw(invalid_argument("Mixed puzzle sizes in input"));
+                }
+                writer->add(puzzle);
+            }
+        }
+        if(!writer){ throw(invalid_argument("No puzzles in input")); }
+        writer->close();
+        packed = writer->size();
+    });
+    cout << "Packed " << packed << " puzzles into " << output << endl;
+}
+
+void unpack(std::string input, std::string output){
+    CorpusReader reader(input);
+    std::ofstream file(output);
+    if(!file){ throw(invalid_argument("Invalid file " + output)); }
+    size_t side_length = reader.shape().side_length;
+    std::vector<char> cells;
+    for(size_t i=0; i<reader.size(); ++i){
+        reader.at(i, cells);
+        if(i!=0) file << '\n';
+        for(size_t r=0; r<side_length; ++r){
+            for(size_t c=0; c<side_length; ++c){
+                file << cells[r*side_length + c];
+                file << (c==side_length-1 ? '\n' : ' ');
+            }
+        }
+    }
+    cout << "Unpacked " << reader.size() << " puzzles into " << output
+        << endl;
+}
+
+int main(int argc, char** argv){
+    std::vector<std::string> args(argv, argv+argc);
+    try{
+        if(args.size() >= 4 && args[1]=="pack"){
+            pack(args[2], std::vector<std::string>(args.begin()+3,
+                        args.end()));
+        }
+        else if(args.size()==4 && args[1]=="unpack"){
+            unpack(args[2], args[3]);
+        }
+        else{
+            cout << "Invalid arguments.\n" << usage << endl;
+            exit(1);
+        }
+    }
+    catch(exception& e){
+        cout << e.what() << '\n' << usage << endl;
+        exit(1);
+    }
+}
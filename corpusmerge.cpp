@@ -0,0 +1,131 @@
+#include "corpus.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+const std::string usage = "Usage: corpusmerge [output] [shard_0 ... shard_N-1]"
+    "\nShard files are the -o outputs of fastsolve --shard i/N, in any order.";
+
+//Interleaves the outputs of fastsolve --shard i/N back into corpus order
+//and totals their stats. Each shard output records its i/N, its mode, how
+//many records it solved and failed, and the record count and checksum of
+//the corpus it came from, so missing, stale or incomplete shards are
+//reported and nothing is written, and only those shards need to be rerun
+//before merging again.
+int main(int argc, char** argv){
+    std::vector<std::string> args(argv, argv+argc);
+    if(args.size() < 3){
+        cout << "Invalid # of args.\n" << usage << endl;
+        exit(1);
+    }
+    std::string output = args[1];
+    std::vector<std::string> files(args.begin()+2, args.end());
+    std::vector<std::unique_ptr<CorpusReader>> readers;
+    bool bad = false;
+    for(const auto& file : files){
+        try{
+            readers.emplace_back(new CorpusReader(file));
+        }
+        catch(exception& e){
+            cout << file << ": " << e.what() << '.' << endl;
+            bad = true;
+        }
+    }
+    if(readers.empty()) exit(1);
+    //the first readable shard says what the rest should match
+    Source source = readers[0]->source();
+    auto shape = readers[0]->shape();
+    size_t num_shards = source.num_shards;
+    std::vector<std::unique_ptr<CorpusReader>> shards(num_shards);
+    std::vector<std::string> names(num_shards);
+    for(size_t k=0; k<readers.size(); ++k){
+        const Source& s = readers[k]->source();
+        auto name = files[k];
+        auto sh = readers[k]->shape();
+        if(s.shard>=s.num_shards || s.mode==Mode::none){
+            cout << name << " is not the output of a shard." << endl;
+            bad = true;
+        }
+        else if(s.checksum!=source.checksum || s.size!=source.size
+                || s.num_shards!=num_shards){
+            cout << name << " is shard " << s.shard << '/' << s.num_shards
+                << " of a different corpus or split than " << files[0]
+                << '.' << endl;
+            bad = true;
+        }
+        else if(s.mode!=source.mode){
+            cout << name << " was made in a different mode (--minimize or "
+                << "--count) than " << files[0] << '.' << endl;
+            bad = true;
+        }
+        else if(sh.side_length!=shape.side_length
+                || sh.box_height!=shape.box_height
+                || sh.box_width!=shape.box_width){
+            cout << name << " has a different puzzle size." << endl;
+            bad = true;
+        }
+        else if(shards[s.shard]){
+            cout << name << " and " << names[s.shard] << " are both shard "
+                << s.shard << '/' << num_shards << '.' << endl;
+            bad = true;
+        }
+        else if(readers[k]->size()!=shard_size(s.size, s.shard,
+                    num_shards)){
+            cout << name << " has " << readers[k]->size() << " records, but"
+                << " shard " << s.shard << '/' << num_shards << " should have "
+                << shard_size(s.size, s.shard, num_shards) << '.' << endl;
+            bad = true;
+        }
+        else{
+            shards[s.shard] = std::move(readers[k]);
+            names[s.shard] = name;
+        }
+    }
+    for(size_t i=0; i<num_shards; ++i){
+        if(shards[i]) continue;
+        cout << "Shard " << i << '/' << num_shards << " is missing or bad."
+            << " Rerun it with --shard " << i << '/' << num_shards << '.'
+            << endl;
+        bad = true;
+    }
+    if(bad) exit(1);
+    size_t total = source.size;
+    size_t total_solved = 0, total_failed = 0;
+    for(const auto& shard : shards){
+        total_solved += shard->source().solved;
+        total_failed += shard->source().failed;
+    }
+    try{
+        write_atomically(output, [&](const std::string& partial){
+            Source merged;
+            merged.checksum = source.checksum;
+            merged.size = source.size;
+            merged.mode = source.mode;
+            CorpusWriter writer(partial, shape, merged);
+            std::vector<char> cells;
+            for(size_t g=0; g<total; ++g){
+                shards[g%num_shards]->at(g/num_shards, cells);
+                writer.add(cells);
+            }
+            writer.close(total_solved, total_failed);
+        });
+    }
+    catch(exception& e){
+        cout << e.what() << endl;
+        exit(1);
+    }
+    for(size_t i=0; i<num_shards; ++i){
+        const Source& s = shards[i]->source();
+        cout << "Shard " << i << '/' << num_shards << ": "
+            << shards[i]->size() << " puzzles, " << s.solved << " solved, "
+            << s.failed << " unsolvable." << endl;
+    }
+    cout << "Merged " << total << " puzzles into " << output << ": "
+        << total_solved << " solved, " << total_failed << " unsolvable."
+        << endl;
+    if(total_failed) exit(1);
+}
@@ -0,0 +1,144 @@
+#ifndef SUDOKU_COUNTER
+#define SUDOKU_COUNTER
+
+#include "fastgrid.hpp"
+#include "fastsolver.hpp"
+#include "checkpoint.hpp"
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <string>
+#include <chrono>
+#include <future>
+#include <cstdint>
+#include <stdexcept>
+
+/*
+ * Counts every solution of a puzzle. The search keeps its own stack of
+ * subproblems instead of recursing, so the whole frontier can be saved
+ * with Checkpoint and the count resumed later with the same result.
+ *
+ * Each subproblem keeps the candidates its parent worked out, so only the
+ * puzzle and the grids of a resumed checkpoint have them rebuilt from
+ * scratch.
+ *
+ * Saving only copies the stack on the search thread; packing and writing
+ * the file happen on a background thread. A checkpoint that comes due
+ * while the previous one is still being written is skipped.
+ */
+template<size_t side_length, size_t box_height, size_t box_width>
+class Counter{
+public:
+    typedef FastGrid<side_length, box_height, box_width> GridType;
+    typedef Solver<side_length, box_height, box_width> SolverType;
+    typedef typename SolverType::PossibilityArray PossibilityArray;
+    Counter(const GridType& g, std::array<char, side_length> allowed_vals) :
+        puzzle_(g), allowed_vals_(allowed_vals), solutions_(0), nodes_(0){
+        push_(g);
+    }
+    //continues from a checkpoint of this puzzle instead of the start
+    void resume(const Checkpoint& checkpoint){
+        auto cells = puzzle_.cells();
+        if(checkpoint.shape.side_length!=side_length
+                || checkpoint.puzzle!=std::vector<char>(cells.begin(),
+                    cells.end())){
+            throw(std::invalid_argument("Checkpoint is for another puzzle."));
+        }
+        solutions_ = checkpoint.solutions;
+        nodes_ = checkpoint.nodes;
+        frontier_.clear();
+        for(const auto& entry : checkpoint.frontier){
+            std::array<char, side_length*side_length> entry_cells;
+            std::copy(entry.begin(), entry.end(), entry_cells.begin());
+            push_(GridType(entry_cells));
+        }
+    }
+    //Searches the rest of the frontier. With a filename, saves a
+    //checkpoint every interval seconds and a final one when done.
+    std::uint64_t count(const std::string& filename="",
+            double interval=60){
+        auto last_save = std::chrono::steady_clock::now();
+        while(!frontier_.empty()){
+            auto node = std::move(frontier_.back());
+            frontier_.pop_back();
+            ++nodes_;
+            SolverType solver(node.first, allowed_vals_, node.second);
+            if(!solver.propagate()) continue;
+            if(solver.solved()){
+                ++solutions_;
+                continue;
+            }
+            auto children = solver.branches();
+            frontier_.insert(frontier_.end(),
+                    std::make_move_iterator(children.rbegin()),
+                    std::make_move_iterator(children.rend()));
+            //only look at the clock every so often
+            if(filename.empty() || nodes_%256) continue;
+            auto now = std::chrono::steady_clock::now();
+            if(std::chrono::duration<double>(now - last_save).count()
+                    >= interval && save_(filename)){
+                last_save = now;
+            }
+        }
+        if(!filename.empty()){
+            finish_save_();
+            save_(filename);
+            finish_save_();
+        }
+        return solutions_;
+    }
+    std::uint64_t nodes() const{return nodes_;}
+private:
+    GridType puzzle_;
+    std::array<char, side_length> allowed_vals_;
+    std::vector<std::pair<GridType, PossibilityArray>> frontier_;
+    std::uint64_t solutions_;
+    std::uint64_t nodes_;
+    std::future<void> pending_save_;
+    //adds a subproblem, working out its candidates from the grid
+    void push_(const GridType& g){
+        try{
+            SolverType solver(g, allowed_vals_);
+            frontier_.emplace_back(g, solver.possibilities());
+        }
+        catch(std::runtime_error&){} //givens that conflict have no solutions
+    }
+    //returns false if the previous checkpoint is still being written
+    bool save_(const std::string& filename){
+        if(pending_save_.valid()){
+            if(pending_save_.wait_for(std::chrono::seconds(0))
+                    !=std::future_status::ready){
+                return false;
+            }
+            pending_save_.get(); //rethrows write errors
+        }
+        std::vector<GridType> frontier;
+        frontier.reserve(frontier_.size());
+        for(const auto& node : frontier_) frontier.push_back(node.first);
+        auto puzzle = puzzle_;
+        auto solutions = solutions_;
+        auto nodes = nodes_;
+        pending_save_ = std::async(std::launch::async,
+                [filename, frontier, puzzle, solutions, nodes](){
+            Checkpoint checkpoint;
+            checkpoint.shape = {side_length, box_height, box_width};
+            checkpoint.solutions = solutions;
+            checkpoint.nodes = nodes;
+            auto cells = puzzle.cells();
+            checkpoint.puzzle.assign(cells.begin(), cells.end());
+            for(const auto& grid : frontier){
+                auto entry = grid.cells();
+                checkpoint.frontier.emplace_back(entry.begin(), entry.end());
+            }
+            checkpoint.write(filename);
+        });
+        return true;
+    }
+    void finish_save_(){
+        if(pending_save_.valid()) pending_save_.get();
+    }
+};
+
+#endif
@@ -1,10 +1,23 @@
 #include "fastgrid.hpp"
 #include "fastsolver.hpp"
+#include "bitboard.hpp"
+#include "minimizer.hpp"
+#include "counter.hpp"
+#include "session.hpp"
+#include "checkpoint.hpp"
+#include "corpus.hpp"
+#include "output.hpp"
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <set>
+#include <vector>
 #include <array>
+#include <memory>
+#include <chrono>
+#include <iomanip>
+#include <new>
 #include <cctype>
 #include <stdexcept>
 
@@ -21,84 +34,516 @@ std::vector<char> read_file(std::string filename){
     return cells;
 }
 
+//a given to set, or to remove if val is '.'
+struct Edit{
+    size_t row;
+    size_t col;
+    char val;
+};
+
+//one edit per line: row, column and value, separated by spaces
+std::vector<Edit> read_edits(std::string filename){
+    std::vector<Edit> edits;
+    std::ifstream file(filename);
+    if(!file){ throw(invalid_argument("Invalid edits file")); }
+    std::string line;
+    while(std::getline(file, line)){
+        if(line.find_first_not_of(" \t\r")==std::string::npos) continue;
+        std::istringstream fields(line);
+        Edit edit;
+        std::string rest;
+        if(!(fields >> edit.row >> edit.col >> edit.val) || fields >> rest){
+            throw(invalid_argument("Invalid edit: " + line + "."));
+        }
+        edits.push_back(edit);
+    }
+    return edits;
+}
+
+enum class Engine{cells, bitboard};
+
+struct Options{
+    bool verbose = false;
+    bool stats = false;
+    Mode mode = Mode::solve;
+    Engine engine = Engine::cells;
+    size_t repeat = 1;
+    size_t threads = 1;
+    TranspositionTable* table = nullptr;
+    Format format = Format::pretty;
+    size_t shard = 0;
+    size_t num_shards = 1;
+    std::string output;
+    std::string checkpoint;
+    double checkpoint_interval = 60;
+    std::vector<Edit> edits;
+};
+
+//results are flushed to stdout once per this many corpus records
+const size_t flush_interval = 4096;
+
+void write_header(const Options& opts){
+    switch(opts.mode){
+        case Mode::solve:
+            write_header(thread_writer(), opts.format, opts.stats);
+            break;
+        case Mode::minimize:
+            write_minimal_header(thread_writer(), opts.format);
+            break;
+        case Mode::count:
+            write_count_header(thread_writer(), opts.format, opts.stats);
+            break;
+        case Mode::edit:
+            write_edit_header(thread_writer(), opts.format, opts.stats);
+            break;
+        case Mode::none:
+            break;
+    }
+}
+
+//what every solver needs to work on a puzzle given as cells
+template<size_t side_length, size_t box_height, size_t box_width>
+struct Problem{
+    FastGrid<side_length, box_height, box_width> grid;
+    std::array<char, side_length> allowed_vals;
+    Shape shape;
+};
+
+template<size_t side_length, size_t box_height, size_t box_width>
+Problem<side_length, box_height, box_width> make_problem(
+        const std::vector<char>& cells){
+    std::array<char, side_length*side_length> cells_array;
+    std::copy(cells.cbegin(), cells.cend(), cells_array.begin());
+    auto syms = symbols(side_length);
+    std::array<char, side_length> allowed_vals{};
+    std::copy(syms.cbegin(), syms.cend(), allowed_vals.begin());
+    return {FastGrid<side_length, box_height, box_width>(cells_array),
+        allowed_vals, {side_length, box_height, box_width}};
+}
+
+//Solves cells in place with the solver that make() returns, and writes
+//the result in the chosen format. Returns false, leaving cells untouched,
+//if the puzzle has no solution.
+template<class MakeSolver>
+bool run_solver(MakeSolver make, std::vector<char>& cells,
+        const Shape& shape, const Options& opts){
+    Writer& out = thread_writer();
+    write_puzzle(out, opts.format, cells, shape);
+    std::vector<char> solution;
+    Stats stats;
+    auto start = chrono::steady_clock::now();
+    //with --repeat, the stats are those of a single run
+    for(size_t i=0; i<opts.repeat; ++i){
+        //a solver throws on givens that conflict, before it has any stats
+        try{
+            auto solver = make();
+            try{
+                solver.solve();
+                auto solved = solver.grid().cells();
+                solution.assign(solved.cbegin(), solved.cend());
+            }
+            catch(runtime_error&){}
+            stats = solver.stats();
+        }
+        catch(runtime_error&){}
+    }
+    stats.micros = chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start).count()/opts.repeat;
+    write_solution(out, opts.format, cells, solution, shape,
+            opts.stats ? &stats : nullptr);
+    if(solution.empty()) return false;
+    cells = solution;
+    return true;
+}
+
+template<size_t side_length, size_t box_height, size_t box_width>
+bool solve_cells(std::vector<char>& cells, const Options& opts){
+    auto problem = make_problem<side_length, box_height, box_width>(cells);
+    if(opts.engine==Engine::bitboard){
+        return run_solver([&](){
+                    return BitboardSolver<side_length, box_height, box_width>(
+                            problem.grid, problem.allowed_vals);
+                }, cells, problem.shape, opts);
+    }
+    return run_solver([&](){
+                return Solver<side_length, box_height, box_width>(
+                        problem.grid, problem.allowed_vals, opts.verbose,
+                        opts.table);
+            }, cells, problem.shape, opts);
+}
+
+//Replaces cells with a minimal puzzle that has the same unique solution,
+//and writes the result in the chosen format. Returns false, leaving cells
+//untouched, if the puzzle is not uniquely solvable.
+template<size_t side_length, size_t box_height, size_t box_width>
+bool minimize_cells(std::vector<char>& cells, const Options& opts){
+    auto problem = make_problem<side_length, box_height, box_width>(cells);
+    Minimizer<side_length, box_height, box_width> minimizer(problem.grid,
+            problem.allowed_vals, opts.threads, opts.table);
+    std::vector<char> minimal;
+    try{
+        auto reduced = minimizer.minimize().cells();
+        minimal.assign(reduced.cbegin(), reduced.cend());
+    }
+    catch(runtime_error&){}
+    write_minimal(thread_writer(), opts.format, cells, minimal, problem.shape,
+            minimal.empty() ? 0 : minimizer.clues());
+    if(minimal.empty()) return false;
+    cells = minimal;
+    return true;
+}
+
+//Counts every solution and writes the count in the chosen format. With
+//a checkpoint file, resumes from it if it exists and saves to it as the
+//search goes. Returns false if there are no solutions.
+template<size_t side_length, size_t box_height, size_t box_width>
+bool count_cells(std::vector<char>& cells, const Options& opts){
+    auto problem = make_problem<side_length, box_height, box_width>(cells);
+    Counter<side_length, box_height, box_width> counter(problem.grid,
+            problem.allowed_vals);
+    if(!opts.checkpoint.empty() && ifstream(opts.checkpoint)){
+        counter.resume(Checkpoint::read(opts.checkpoint));
+    }
+    auto start = chrono::steady_clock::now();
+    auto solutions = counter.count(opts.checkpoint, opts.checkpoint_interval);
+    Stats stats;
+    stats.nodes = counter.nodes();
+    stats.micros = chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start).count();
+    write_count(thread_writer(), opts.format, cells, solutions,
+            opts.stats ? &stats : nullptr);
+    return solutions;
+}
+
+//Solves the puzzle, then applies the edits one at a time, writing the
+//puzzle's solutions after each in the chosen format. Returns false if the
+//final puzzle has no solution.
+template<size_t side_length, size_t box_height, size_t box_width>
+bool edit_cells(std::vector<char>& cells, const Options& opts){
+    auto problem = make_problem<side_length, box_height, box_width>(cells);
+    Session<side_length, box_height, box_width> session(problem.grid,
+            problem.allowed_vals, opts.table);
+    for(const auto& edit : opts.edits){
+        auto start = chrono::steady_clock::now();
+        session.set(edit.row, edit.col, edit.val);
+        Stats stats = session.stats();
+        stats.micros = chrono::duration_cast<chrono::microseconds>(
+                chrono::steady_clock::now() - start).count();
+        auto puzzle = session.puzzle().cells();
+        std::vector<char> solution;
+        if(session.solutions()){
+            auto solved = session.solution().cells();
+            solution.assign(solved.cbegin(), solved.cend());
+        }
+        write_edit(thread_writer(), opts.format, edit.row, edit.col,
+                edit.val, std::vector<char>(puzzle.cbegin(), puzzle.cend()),
+                solution, session.solutions(), problem.shape,
+                opts.stats ? &stats : nullptr);
+    }
+    return session.solutions();
+}
+
+template<size_t side_length, size_t box_height, size_t box_width>
+bool process_cells(std::vector<char>& cells, const Options& opts){
+    switch(opts.mode){
+        case Mode::minimize:
+            return minimize_cells<side_length, box_height, box_width>(cells,
+                    opts);
+        case Mode::count:
+            return count_cells<side_length, box_height, box_width>(cells,
+                    opts);
+        case Mode::edit:
+            return edit_cells<side_length, box_height, box_width>(cells,
+                    opts);
+        default:
+            return solve_cells<side_length, box_height, box_width>(cells,
+                    opts);
+    }
+}
+
+bool process_cells(std::vector<char>& cells, const Options& opts){
+    switch(cells.size()){
+        case 16: return process_cells<4,2,2>(cells, opts);
+        case 36: return process_cells<6,2,3>(cells, opts);
+        case 81: return process_cells<9,3,3>(cells, opts);
+        case 256: return process_cells<16,4,4>(cells, opts);
+        default:
+            throw(invalid_argument("Unrecognized puzzle size. Allowed sizes "
+                        "are 4x4, 6x6, 9x9, and 16x16."));
+    }
+}
+
+//Solves (or minimizes, or counts) the records of a corpus that belong to
+//this shard: record i goes to shard i%num_shards. With an output file, the results
+//(or the original puzzle, for failed records) are written in shard order,
+//along with the mode and how many records were solved and failed;
+//corpusmerge interleaves the shards back into corpus order. An output that
+//already holds this shard of this corpus in this mode is kept, and the
+//shard skipped.
+bool solve_corpus(std::string filename, const Options& opts){
+    CorpusReader corpus(filename);
+    auto shape = corpus.shape();
+    auto expected = shape_for(shape.side_length);
+    if(shape.box_height!=expected.box_height
+            || shape.box_width!=expected.box_width){
+        throw(invalid_argument("Unsupported box shape"));
+    }
+    Source source;
+    source.checksum = corpus.checksum();
+    source.size = corpus.size();
+    source.shard = opts.shard;
+    source.num_shards = opts.num_shards;
+    source.mode = opts.mode;
+    size_t solved = 0, failed = 0;
+    auto report = [&](){
+        cerr << "Shard " << opts.shard << '/' << opts.num_shards << ": "
+            << solved + failed << " puzzles, " << solved << " solved, "
+            << failed << " unsolvable." << endl;
+    };
+    if(!opts.output.empty()){
+        try{
+            CorpusReader done(opts.output);
+            const Source& saved = done.source();
+            if(saved.checksum==source.checksum && saved.size==source.size
+                    && saved.shard==source.shard
+                    && saved.num_shards==source.num_shards
+                    && saved.mode==source.mode
+                    && done.size()==shard_size(source.size, source.shard,
+                        source.num_shards)){
+                cerr << opts.output << " is already complete, skipping."
+                    << endl;
+                solved = saved.solved;
+                failed = saved.failed;
+                report();
+                return !failed;
+            }
+        }
+        catch(exception&){} //missing or incomplete, so (re)run the shard
+    }
+    Writer& out = thread_writer();
+    auto run = [&](CorpusWriter* writer){
+        write_header(opts);
+        std::vector<char> cells;
+        for(size_t i=opts.shard; i<corpus.size(); i+=opts.num_shards){
+            if(opts.format==Format::pretty) out << "Puzzle " << i << ":\n";
+            corpus.at(i, cells);
+            if(process_cells(cells, opts)) ++solved;
+            else ++failed;
+            if(writer) writer->add(cells);
+            if(opts.format==Format::pretty) out << '\n';
+            if((solved + failed)%flush_interval==0) out.flush();
+        }
+        out.flush();
+        if(writer) writer->close(solved, failed);
+    };
+    if(opts.output.empty()) run(nullptr);
+    else{
+        write_atomically(opts.output, [&](const std::string& partial){
+            CorpusWriter writer(partial, shape, source);
+            run(&writer);
+        });
+    }
+    report();
+    return !failed;
+}
+
+void parse_shard(std::string spec, Options& opts){
+    auto slash = spec.find('/');
+    try{
+        if(slash==std::string::npos) throw(invalid_argument(spec));
+        opts.shard = std::stoul(spec.substr(0, slash));
+        opts.num_shards = std::stoul(spec.substr(slash+1));
+    }
+    catch(logic_error&){
+        throw(invalid_argument("Invalid shard: " + spec + "."));
+    }
+    if(opts.num_shards==0 || opts.shard>=opts.num_shards){
+        throw(invalid_argument("Invalid shard: " + spec + "."));
+    }
+}
+
 int main(int argc, char** argv){
-    //read file
-    std::string usage = "Usage: fastsolve [filename]";
-    std::vector<char> cells;
-    bool verbose=false;
-    switch(argc){
-        case 3:
-            if (string(argv[1]) == "-v"){
-                verbose=true;
+    std::string usage = "Usage: fastsolve [-v] [--format pretty|compact|csv|"
+        "json] [--stats] [--minimize | --count] [--engine cells|bitboard] "
+        "[--repeat n] [-j threads] "
+        "[--tt-mb megabytes] [--tt-replace always|larger] "
+        "[--checkpoint file] [--checkpoint-interval seconds] [--edits file] "
+        "[--shard i/N] "
+        "[-o output] [filename]";
+    std::vector<std::string> args(argv+1, argv+argc);
+    Options opts;
+    std::string filename;
+    size_t table_mb = 0;
+    std::unique_ptr<TranspositionTable> table;
+    Replacement replacement = Replacement::larger;
+    try{
+        for(size_t i=0; i<args.size(); ++i){
+            auto arg = args[i];
+            if(arg=="-v"){
+                opts.verbose=true;
             }
-            else{
-                cout << "Unrecognized argument: " << argv[1] << "."
-                    << usage << endl;
-                exit(1);
+            else if(arg=="--stats"){
+                opts.stats=true;
             }
-            try{
-                cells = read_file(argv[2]);
+            else if(arg=="--minimize"){
+                opts.mode=Mode::minimize;
             }
-            catch(invalid_argument e){
-                cout << e.what() << ' ' << usage << endl;
+            else if(arg=="--count"){
+                opts.mode=Mode::count;
             }
-            break;
-        case 2:
-            try{
-                cells = read_file(argv[1]);
+            else if((arg=="--format" || arg=="--engine" || arg=="--repeat"
+                        || arg=="-j" || arg=="--tt-mb"
+                        || arg=="--tt-replace" || arg=="--checkpoint"
+                        || arg=="--checkpoint-interval" || arg=="--edits"
+                        || arg=="--shard"
+                        || arg=="-o") && i+1==args.size()){
+                throw(invalid_argument("Missing value for " + arg + "."));
             }
-            catch(invalid_argument e){
-                cout << e.what() << ' ' << usage << endl;
+            else if(arg=="--format"){
+                opts.format = parse_format(args[++i]);
+            }
+            else if(arg=="--engine"){
+                auto engine = args[++i];
+                if(engine=="cells") opts.engine = Engine::cells;
+                else if(engine=="bitboard") opts.engine = Engine::bitboard;
+                else throw(invalid_argument("Unknown engine: " + engine
+                            + "."));
+            }
+            else if(arg=="--repeat"){
+                try{ opts.repeat = std::stoul(args[++i]); }
+                catch(logic_error&){
+                    throw(invalid_argument("Invalid repeat count."));
+                }
+                if(!opts.repeat){
+                    throw(invalid_argument("Invalid repeat count."));
+                }
+            }
+            else if(arg=="-j"){
+                try{ opts.threads = std::stoul(args[++i]); }
+                catch(logic_error&){
+                    throw(invalid_argument("Invalid thread count."));
+                }
+            }
+            else if(arg=="--tt-mb"){
+                try{ table_mb = std::stoul(args[++i]); }
+                catch(logic_error&){
+                    throw(invalid_argument("Invalid table size."));
+                }
+            }
+            else if(arg=="--tt-replace"){
+                replacement = parse_replacement(args[++i]);
+            }
+            else if(arg=="--checkpoint"){
+                opts.checkpoint = args[++i];
+            }
+            else if(arg=="--checkpoint-interval"){
+                try{ opts.checkpoint_interval = std::stod(args[++i]); }
+                catch(logic_error&){
+                    throw(invalid_argument("Invalid checkpoint interval."));
+                }
+            }
+            else if(arg=="--edits"){
+                opts.mode = Mode::edit;
+                opts.edits = read_edits(args[++i]);
+            }
+            else if(arg=="--shard"){
+                parse_shard(args[++i], opts);
+            }
+            else if(arg=="-o"){
+                opts.output = args[++i];
+            }
+            else if(arg.size()>1 && arg[0]=='-'){
+                throw(invalid_argument("Unrecognized argument: " + arg
+                            + "."));
+            }
+            else if(filename.empty()){
+                filename = arg;
+            }
+            else{
+                throw(invalid_argument("Invalid # of args."));
             }
-            break;
-        default:
-            cout << "Invalid # of args. " << usage << endl; 
-            exit(1);
-            break;
-    }
-    //solve
-    switch(cells.size()){
-        case 16:{
-            std::array<char, 16> cells_array;
-            std::copy(cells.cbegin(), cells.cend(), cells_array.begin());
-            std::array<char, 4> allowed_vals = {{'1','2','3','4'}};
-            FastGrid<4,2,2> grid(cells_array);
-            Solver<4,2,2>(grid, allowed_vals, verbose).solve();
-            break;
         }
-        case 36:{
-            std::array<char, 36> cells_array;
-            std::copy(cells.cbegin(), cells.cend(), cells_array.begin());
-            std::array<char, 6> allowed_vals = 
-                {{'1','2','3','4','5','6'}};
-            FastGrid<6,2,3> grid(cells_array);
-            Solver<6,2,3>(grid, allowed_vals, verbose).solve();
-            break;
+        if(filename.empty()){
+            throw(invalid_argument("Invalid # of args."));
         }
-        case 81:{
-            std::array<char, 81> cells_array;
-            std::copy(cells.cbegin(), cells.cend(), cells_array.begin());
-            std::array<char, 9> allowed_vals = 
-                {{'1','2','3','4','5','6','7','8','9'}};
-            FastGrid<9,3,3> grid(cells_array);
-            Solver<9,3,3>(grid, allowed_vals, verbose).solve();
-            break;
+        if(!opts.checkpoint.empty() && opts.mode!=Mode::count){
+            throw(invalid_argument("--checkpoint needs --count."));
         }
-        case 256:{
-            std::array<char, 256> cells_array;
-            std::copy(cells.cbegin(), cells.cend(), cells_array.begin());
-            std::array<char, 16> allowed_vals = 
-                {{'1','2','3','4','5','6','7','8','9','0',
-                     'A','B','C','D','E','F'}};
-            FastGrid<16,4,4> grid(cells_array);
-            Solver<16,4,4>(grid, allowed_vals, verbose).solve();
-            break;
+        //the -v trace goes to stdout, where it would break up the records
+        //of every other format
+        if(opts.verbose && opts.format!=Format::pretty){
+            throw(invalid_argument("-v needs --format pretty."));
+        }
+        //the bitboard engine has no verbose trace or transposition table
+        if(opts.engine==Engine::bitboard && (opts.verbose || table_mb)){
+            throw(invalid_argument("--engine bitboard does not support -v "
+                        "or --tt-mb."));
+        }
+        //only plain solving picks an engine or repeats; the other modes
+        //always run the cells solver once
+        if(opts.engine==Engine::bitboard && opts.mode!=Mode::solve){
+            throw(invalid_argument("--engine bitboard does not support "
+                        "--minimize, --count or --edits."));
+        }
+        if(opts.repeat!=1 && opts.mode!=Mode::solve){
+            throw(invalid_argument("--repeat does not apply to --minimize, "
+                        "--count or --edits."));
         }
-        default:{
-            cout << "Unrecognized puzzle size. " 
-                << "Allowed sizes are 4x4, 6x6, 9x9, and 16x16."
-                << endl;
-            exit(1);
+        //the counter never consults the transposition table
+        if(table_mb && opts.mode==Mode::count){
+            throw(invalid_argument("--count does not support --tt-mb."));
         }
+        if(table_mb){
+            try{
+                table.reset(new TranspositionTable(table_mb, replacement));
+            }
+            catch(bad_alloc&){
+                throw(invalid_argument("Not enough memory for a "
+                            + std::to_string(table_mb)
+                            + " MB transposition table."));
+            }
+            opts.table = table.get();
+        }
+    }
+    catch(invalid_argument& e){
+        cout << e.what() << ' ' << usage << endl;
+        exit(1);
+    }
+    //solve a packed corpus record by record, or a single text puzzle
+    bool solved;
+    try{
+        if(is_corpus(filename)){
+            if(!opts.checkpoint.empty()){
+                throw(invalid_argument("--checkpoint needs a single puzzle."));
+            }
+            if(opts.mode==Mode::edit){
+                throw(invalid_argument("--edits needs a single puzzle."));
+            }
+            solved = solve_corpus(filename, opts);
+        }
+        else if(opts.num_shards!=1 || !opts.output.empty()){
+            throw(invalid_argument("--shard and -o need a corpus file."));
+        }
+        else{
+            auto cells = read_file(filename);
+            write_header(opts);
+            solved = process_cells(cells, opts);
+            thread_writer().flush();
+        }
+    }
+    catch(exception& e){
+        thread_writer().flush();
+        cout << e.what() << ' ' << usage << endl;
+        exit(1);
+    }
+    if(opts.stats && table){
+        auto counters = table->counters();
+        cerr << "Transposition table: " << counters.probes << " probes, "
+            << counters.hits << " hits ("
+            << fixed << setprecision(3)
+            << (counters.probes ? 100.0*counters.hits/counters.probes : 0.0)
+            << "%), " << counters.stores << " stores, "
+            << counters.nodes_saved << " nodes saved." << endl;
     }
+    if(!solved) exit(1);
 }
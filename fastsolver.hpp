@@ -2,66 +2,248 @@
 #define SUDOKU_FASTSOLVER
 
 #include "fastgrid.hpp"
+#include "output.hpp"
+#include "transposition.hpp"
 #include <array>
-#include <set>
+#include <string>
+#include <initializer_list>
+#include <vector>
+#include <cstdint>
 #include <algorithm>
-#include <iostream>
+#include <stdexcept>
+
+/*
+ * Set of cell values stored as a bitmask over the symbols '0'-'9', 'A'-'Z'.
+ * Has the parts of the std::set<char> interface the solver uses, iterates
+ * in the same order, and is cheap to copy when the search saves state.
+ */
+class CandidateSet{
+public:
+    class const_iterator{
+    public:
+        const_iterator(unsigned long long bits) : bits_(bits) {}
+        char operator*() const{return '0' + __builtin_ctzll(bits_);}
+        const_iterator& operator++(){
+            bits_ &= bits_-1;
+            return *this;
+        }
+        bool operator!=(const const_iterator& o) const{
+            return bits_!=o.bits_;
+        }
+    private:
+        unsigned long long bits_;
+    };
+    CandidateSet() : bits_(0) {}
+    CandidateSet(std::initializer_list<char> vals) : bits_(0){
+        for(char val : vals) insert(val);
+    }
+    void insert(char val){bits_ |= bit_(val);}
+    void erase(char val){bits_ &= ~bit_(val);}
+    void clear(){bits_ = 0;}
+    size_t count(char val) const{return (bits_ & bit_(val)) ? 1 : 0;}
+    size_t size() const{return __builtin_popcountll(bits_);}
+    bool empty() const{return !bits_;}
+    const_iterator begin() const{return const_iterator(bits_);}
+    const_iterator end() const{return const_iterator(0);}
+private:
+    unsigned long long bits_;
+    static unsigned long long bit_(char val){
+        return 1ULL << (val - '0');
+    }
+};
 
 template<size_t side_length, size_t box_height, size_t box_width>
 class Solver{
 public:
     typedef FastGrid<side_length, box_height, box_width> GridType;
+    typedef std::array<std::array<CandidateSet, side_length>, side_length> 
+        PossibilityArray;
     Solver(const GridType& g, std::array<char, side_length> allowed_vals,
-            bool verbose=false) : grid_(g), allowed_vals_(allowed_vals), 
-        verbose_(verbose) {initialize_possiblities_();}
-    void solve(bool recursed=false){
-        if(!recursed){
-            std::cout << "Initial puzzle:" << std::endl;
-            print_();
-            std::cout << std::endl;
-        }
+            bool verbose=false, TranspositionTable* table=nullptr) :
+        grid_(g), allowed_vals_(allowed_vals), verbose_(verbose),
+        table_(table){
+        check_givens_();
+        initialize_possiblities_();
+        initialize_key_();
+    }
+    //starts from candidates already worked out for g (each given holding
+    //just its own value), instead of recalculating them
+    Solver(const GridType& g, std::array<char, side_length> allowed_vals,
+            const PossibilityArray& possibilities, bool verbose=false,
+            TranspositionTable* table=nullptr) :
+        grid_(g), allowed_vals_(allowed_vals), verbose_(verbose),
+        possibilities_(possibilities), table_(table) {initialize_key_();}
+    void solve(){
         while(!solved_()){
             if(from_possibilities_() || from_necessity_()){
                 if(verbose_){
                     print_();
-                    std::cout << std::endl;
+                    thread_writer() << '\n';
                 }
             }
             else{
-                std::cout << "brute forcing :-(" << std::endl;
+                if(verbose_) thread_writer() << "brute forcing :-(\n";
                 brute_force_();
             }
         }
-        if(!recursed){ 
-            std::cout << "Solved puzzle:" << std::endl;
-            print_();
+    }
+    //Counts solutions, stopping early once limit have been found, and
+    //copies the first one found to first if given. The solver's own grid
+    //is left as it was.
+    size_t count_solutions(size_t limit=2, GridType* first=nullptr){
+        auto current_grid = grid_;
+        auto current_possibilities = possibilities_;
+        auto current_key = key_;
+        size_t found = 0;
+        try{
+            while(!solved_() && (from_possibilities_() || from_necessity_()));
+            if(solved_()){
+                found = 1;
+                if(first) *first = grid_;
+            }
+            else{
+                auto cell = branch_cell_();
+                auto branch_possibilities = possibilities_;
+                auto branch_grid = grid_;
+                auto branch_key = key_;
+                for(auto possibility : branch_possibilities[cell.first]
+                        [cell.second]){
+                    size_t nodes_before = stats_.guesses++;
+                    set_(cell.first, cell.second, possibility);
+                    if(!table_ || !table_->dead(key_)){
+                        size_t sub = count_solutions(limit-found,
+                                found ? nullptr : first);
+                        if(!sub && table_){
+                            table_->store(key_, stats_.guesses-nodes_before);
+                        }
+                        found += sub;
+                    }
+                    grid_ = branch_grid;
+                    possibilities_ = branch_possibilities;
+                    key_ = branch_key;
+                    if(found>=limit) break;
+                }
+            }
+        }
+        catch(std::runtime_error&){
+            ++stats_.contradictions;
+        }
+        grid_ = current_grid;
+        possibilities_ = current_possibilities;
+        key_ = current_key;
+        return found;
+    }
+    //rules out val at an empty cell, on top of what the grid implies
+    void eliminate(size_t r, size_t c, char val){
+        if(!possibilities_[r][c].count(val)) return;
+        possibilities_[r][c].erase(val);
+        auto key = zobrist_(r*side_length + c, val, true);
+        key_ ^= key;
+        eliminations_.push_back(std::make_pair(r*side_length + c, key));
+    }
+    //Applies the deduction rules until they stop making progress. Returns
+    //false if they hit a contradiction.
+    bool propagate(){
+        try{
+            while(!solved_() && (from_possibilities_() || from_necessity_()));
         }
+        catch(std::runtime_error&){
+            ++stats_.contradictions;
+            return false;
+        }
+        return true;
+    }
+    //one grid per candidate of the cell the search would branch on, in
+    //the order the search tries them, each with its candidates
+    std::vector<std::pair<GridType, PossibilityArray>> branches() const{
+        auto cell = branch_cell_();
+        std::vector<std::pair<GridType, PossibilityArray>> children;
+        for(auto possibility : possibilities_[cell.first][cell.second]){
+            Solver child(*this);
+            child.set_(cell.first, cell.second, possibility);
+            children.emplace_back(child.grid_, child.possibilities_);
+        }
+        return children;
+    }
+    bool solved() const{return solved_();}
+    //whether some row, column or box of g holds the same given twice
+    static bool conflicting(const GridType& g){
+        for(const auto& group : g.all_groups()){
+            CandidateSet seen;
+            for(char val : group){
+                if(val=='.') continue;
+                if(seen.count(val)) return true;
+                seen.insert(val);
+            }
+        }
+        return false;
     }
+    const GridType& grid() const{return grid_;}
+    const PossibilityArray& possibilities() const{return possibilities_;}
+    const Stats& stats() const{return stats_;}
 private:
-    typedef std::array<std::array<std::set<char>, side_length>, side_length> 
-        PossibilityArray;
     GridType grid_;
     std::array<char, side_length> allowed_vals_;
     bool verbose_;
     PossibilityArray possibilities_;
+    Stats stats_;
+    TranspositionTable* table_;
+    //Zobrist key of the placements, and of the eliminations at cells that
+    //are still empty, which together determine possibilities_
+    std::uint64_t key_;
+    std::vector<std::pair<size_t, std::uint64_t>> eliminations_;
+    static std::uint64_t zobrist_(size_t cell, char val, bool eliminated){
+        //one random key per (cell, symbol, placed or eliminated)
+        static const std::vector<std::uint64_t> keys = [](){
+            std::vector<std::uint64_t> k(2*side_length*side_length*64);
+            std::uint64_t state = 0x9E3779B97F4A7C15ULL*side_length;
+            for(auto& key : k){ //splitmix64
+                std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+                key = z ^ (z >> 31);
+            }
+            return k;
+        }();
+        return keys[(2*cell + eliminated)*64 + ((val - '0') & 63)];
+    }
+    void initialize_key_(){
+        key_ = 0;
+        for(size_t r=0; r<side_length; ++r){
+            for(size_t c=0; c<side_length; ++c){
+                if(grid_.at(r,c)!='.'){
+                    key_ ^= zobrist_(r*side_length + c, grid_.at(r,c), false);
+                }
+            }
+        }
+    }
+    //CandidateSet can only hold allowed values, and the deductions assume
+    //that the givens agree with each other
+    void check_givens_() const{
+        for(char val : grid_.cells()){
+            if(val!='.' && std::find(allowed_vals_.begin(),
+                        allowed_vals_.end(), val)==allowed_vals_.end()){
+                throw(std::invalid_argument(std::string("Invalid cell value: ")
+                            + val));
+            }
+        }
+        if(conflicting(grid_)){
+            throw(std::runtime_error("No solutions: the givens conflict."));
+        }
+    }
     bool solved_() const{
         auto cells = grid_.cells();
         auto filled = [](char c){return c!='.';};
         return std::all_of(cells.begin(), cells.end(), filled);
     }
-    bool conflicts_(size_t r, size_t c, char val) const{
-        auto groups = grid_.groups(r,c);
-        for(auto group : groups){
-            if(std::find(group.begin(), group.end(), val)!=group.end()) 
-                return true;
-        }
-        return false;
-    }
-    std::set<char> calculate_possibilities_(size_t r, size_t c) const{
+    CandidateSet calculate_possibilities_(size_t r, size_t c) const{
         if(grid_.at(r,c) !='.') return {grid_.at(r,c)};
-        std::set<char> candidates;
-        for(char val : allowed_vals_){
-            if(!conflicts_(r,c,val)) candidates.insert(val);
+        CandidateSet candidates;
+        for(char val : allowed_vals_) candidates.insert(val);
+        for(auto group : grid_.groups(r,c)){
+            for(char val : group){
+                if(val!='.') candidates.erase(val);
+            }
         }
         return candidates;
     }
@@ -73,6 +255,15 @@ private:
         }
     }
     void set_(size_t r, size_t c, size_t val){
+        if(grid_.at(r,c)=='.'){
+            //once filled, the cell no longer depends on its eliminations
+            key_ ^= zobrist_(r*side_length + c, val, false);
+            for(auto elimination : eliminations_){
+                if(elimination.first==r*side_length + c){
+                    key_ ^= elimination.second;
+                }
+            }
+        }
         grid_.set(r,c,val);
         size_t b = grid_.box_num(r,c);
         for(size_t i=0; i<side_length; ++i){ 
@@ -87,24 +278,9 @@ private:
         possibilities_[r][c].insert(val);
     }
     void print_() const{
-        for(size_t r=0; r<side_length; ++r){
-            //print horizontal bars
-            if(!(r%box_height) && r!=0){
-                size_t num_bars = side_length/box_width-1;
-                size_t num_chars = side_length;
-                size_t num_spaces = num_bars+num_chars-1;
-                size_t line_length = num_bars + num_chars + num_spaces;
-                for(size_t c=0; c<line_length; ++c) std::cout << '-';
-                std::cout << std::endl;
-            }
-            //print others
-            for(size_t c=0; c<side_length; ++c){
-                if(!(c%box_width) && c!=0) std::cout << "| ";
-                std::cout << grid_.at(r,c);
-                if(c!=side_length-1) std::cout << ' ';
-            }
-            std::cout << std::endl;
-        }
+        auto cells = grid_.cells();
+        write_grid(thread_writer(), std::vector<char>(cells.begin(),
+                    cells.end()), {side_length, box_height, box_width});
     }
     bool from_possibilities_(){
         bool changed = false;
@@ -113,7 +289,7 @@ private:
                 //only consider cells that are currently empty
                 if(grid_.at(r,c)!='.') continue;
                 //find possibilities for cell
-                auto candidates = possibilities_[r][c];
+                const auto& candidates = possibilities_[r][c];
                 //if there are no possibilities, we've hit a dead end
                 if(candidates.empty()){
                     std::string coord = "(" + std::to_string(r)
@@ -125,8 +301,8 @@ private:
                 if(candidates.size()==1){
                     auto val = *candidates.begin();
                     if(verbose_){
-                        std::cout << '(' << r << ',' << c << ')'
-                            << " can only be " << val << std::endl; 
+                        thread_writer() << '(' << r << ',' << c << ')'
+                            << " can only be " << val << '\n'; 
                     }
                     set_(r,c,val);
                     changed = true;
@@ -135,8 +311,8 @@ private:
         }
         return changed;
     }
-    std::set<char> needs_(typename GridType::Group group){
-        std::set<char> needed_vals;
+    CandidateSet needs_(typename GridType::Group group){
+        CandidateSet needed_vals;
         for(char c : allowed_vals_){
             if(std::find(group.begin(), group.end(), c)==group.end()){
                 needed_vals.insert(c);
@@ -175,16 +351,24 @@ private:
             auto needed_vals = needs_(all_groups[g]);
             for(char val : needed_vals){
                 //find places they can go
-                std::vector<size_t> possible_locs;
-                for(size_t p=0; p<side_length; ++p){
+                size_t num_locs = 0, last_loc = 0;
+                for(size_t p=0; p<side_length && num_locs<2; ++p){
                     size_t r = coords_from_group_(g,p).first;
                     size_t c = coords_from_group_(g,p).second;
-                    if(possibilities_[r][c].count(val)) 
-                        possible_locs.push_back(p);
+                    if(possibilities_[r][c].count(val)){
+                        ++num_locs;
+                        last_loc = p;
+                    }
+                }
+                //if they can't go anywhere, we've hit a dead end
+                if(num_locs==0){
+                    std::string error = "No place for " + std::string(1, val)
+                        + " in group " + std::to_string(g) + ".";
+                    throw(std::runtime_error(error));
                 }
                 //if they can only go in one place, add them
-                if(possible_locs.size()==1){
-                    size_t p = possible_locs.front();
+                if(num_locs==1){
+                    size_t p = last_loc;
                     size_t r = coords_from_group_(g,p).first;
                     size_t c = coords_from_group_(g,p).second;
                     if(verbose_){
@@ -194,9 +378,9 @@ private:
                             case 1: grouptype="Col"; break;
                             default: grouptype="Box"; break;
                         }
-                        std::cout << grouptype << ' ' << g%side_length
+                        thread_writer() << grouptype << ' ' << g%side_length
                             << " needs " << val << ", can only go at "
-                            << '(' << r << ',' << c << ')' << std::endl;
+                            << '(' << r << ',' << c << ')' << '\n';
                     }
                     set_(r,c,val);
                     changed = true;
@@ -205,10 +389,10 @@ private:
         }
         return changed;
     }
-    void brute_force_(){
+    std::pair<size_t, size_t> branch_cell_() const{
         //find element with least possibilities
         size_t min_possibililies = side_length+1; //more than max possible
-        size_t min_r, min_c; 
+        size_t min_r = 0, min_c = 0; 
         for(size_t r=0; r<side_length; ++r){
             for(size_t c=0; c<side_length; ++c){
                 size_t num_possibilities = possibilities_[r][c].size();
@@ -220,31 +404,50 @@ private:
                 }
             }
         }
+        return std::make_pair(min_r, min_c);
+    }
+    void brute_force_(){
+        auto cell = branch_cell_();
+        size_t min_r = cell.first, min_c = cell.second;
         //save current state
         auto current_grid = grid_;
         auto current_possibilities = possibilities_;
+        auto current_key = key_;
         //try out all possibilities
         for(auto possibility : current_possibilities[min_r][min_c]){
+            size_t nodes_before = stats_.guesses++;
+            std::uint64_t branch_key = 0;
+            bool known_dead = false;
             try{ //make change and try to solve new puzzle
                 set_(min_r,min_c,possibility);
+                branch_key = key_;
+                if(table_ && table_->dead(branch_key)){
+                    known_dead = true;
+                    throw(std::runtime_error("Known dead end."));
+                }
                 if(verbose_){
-                    std::cout << "Trying " << possibility << " at "
-                        << '(' << min_r << "," << min_c << ')' << std::endl;
+                    thread_writer() << "Trying " << possibility << " at "
+                        << '(' << min_r << "," << min_c << ')' << '\n';
                     print_();
-                    std::cout << std::endl;
+                    thread_writer() << '\n';
                 }
-                solve(true);
+                solve();
                 break;
             }
             catch(std::runtime_error e){ //reset
+                ++stats_.contradictions;
+                if(table_ && !known_dead){
+                    table_->store(branch_key, stats_.guesses-nodes_before);
+                }
                 grid_ = current_grid;
                 possibilities_ = current_possibilities;
+                key_ = current_key;
                 if(verbose_){
-                    std::cout << "Contradiction found: " << e.what() 
-                        << std::endl;
-                    std::cout << "Backing up to:" << std::endl;
+                    thread_writer() << "Contradiction found: " << e.what() 
+                        << '\n';
+                    thread_writer() << "Backing up to:" << '\n';
                     print_();
-                    std::cout << std::endl;
+                    thread_writer() << '\n';
                 }
             }
         }
@@ -0,0 +1,122 @@
+#ifndef SUDOKU_MINIMIZER
+#define SUDOKU_MINIMIZER
+
+#include "fastgrid.hpp"
+#include "fastsolver.hpp"
+#include "session.hpp"
+#include <array>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+
+/*
+ * Reduces a uniquely solvable puzzle to a minimal one: removing any of the
+ * remaining givens would allow a second solution.
+ *
+ * Givens are tried in order, one window of num_threads givens at a time,
+ * with the trials of a window run in parallel. Each trial removes its
+ * given from a copy of a Session on the current puzzle, which keeps the
+ * candidates of the givens between removals and, because the solution is
+ * already known, only looks for a solution that differs from it at the
+ * removed cell. Givens whose removal breaks uniqueness stay essential for
+ * good (taking away more givens only adds solutions).
+ *
+ * The givens a window finds removable are each removable on their own, but
+ * not necessarily together, so removing each longer run of them from the
+ * start (the first two, the first three, ...) is then solved in parallel
+ * as well. The longest run that keeps the solution unique is dropped, just
+ * as removing its givens one at a time would have, the given after it is
+ * essential, and the rest are retried against the smaller puzzle. With one
+ * thread this is the plain one-pass greedy reduction, and any number of
+ * threads gives the same result.
+ */
+template<size_t side_length, size_t box_height, size_t box_width>
+class Minimizer{
+public:
+    typedef FastGrid<side_length, box_height, box_width> GridType;
+    typedef Session<side_length, box_height, box_width> SessionType;
+    Minimizer(const GridType& g, std::array<char, side_length> allowed_vals,
+            size_t num_threads=1, TranspositionTable* table=nullptr) :
+        puzzle_(g), allowed_vals_(allowed_vals),
+        num_threads_(num_threads ? num_threads : 1), table_(table) {}
+    GridType minimize(){
+        SessionType session(puzzle_, allowed_vals_, table_);
+        if(session.solutions()!=1){
+            throw(std::runtime_error("Puzzle does not have a unique "
+                        "solution."));
+        }
+        std::vector<size_t> candidates;
+        auto cells = puzzle_.cells();
+        for(size_t i=0; i<cells.size(); ++i){
+            if(cells[i]!='.') candidates.push_back(i);
+        }
+        while(!candidates.empty()){
+            size_t window = std::min(num_threads_, candidates.size());
+            std::vector<SessionType> trials(window, session);
+            parallel_(window, [&](size_t k){
+                    trials[k].set(candidates[k]/side_length,
+                            candidates[k]%side_length, '.');
+                });
+            std::vector<size_t> removable;
+            for(size_t k=0; k<window; ++k){
+                if(trials[k].solutions()==1) removable.push_back(k);
+            }
+            //runs[i] has the first i+1 removable givens removed
+            std::vector<std::unique_ptr<SessionType>> runs(removable.size());
+            parallel_(removable.size(), [&](size_t i){
+                    if(!i) return;
+                    GridType reduced(session.puzzle());
+                    for(size_t k=0; k<=i; ++k){
+                        reduced.set(candidates[removable[k]]/side_length,
+                                candidates[removable[k]]%side_length, '.');
+                    }
+                    runs[i].reset(new SessionType(reduced, allowed_vals_,
+                                table_));
+                });
+            size_t dropped = removable.empty() ? 0 : 1;
+            while(dropped<runs.size() && runs[dropped]->solutions()==1){
+                ++dropped;
+            }
+            if(dropped==1) session = trials[removable[0]];
+            else if(dropped) session = *runs[dropped-1];
+            std::vector<size_t> remaining;
+            for(size_t i=dropped+1; i<removable.size(); ++i){
+                remaining.push_back(candidates[removable[i]]);
+            }
+            remaining.insert(remaining.end(), candidates.begin() + window,
+                    candidates.end());
+            candidates = remaining;
+        }
+        puzzle_ = session.puzzle();
+        return puzzle_;
+    }
+    size_t clues() const{
+        auto cells = puzzle_.cells();
+        return std::count_if(cells.begin(), cells.end(),
+                [](char c){return c!='.';});
+    }
+private:
+    GridType puzzle_;
+    std::array<char, side_length> allowed_vals_;
+    size_t num_threads_;
+    TranspositionTable* table_;
+    //calls f(k) for every k below count, on up to num_threads_ threads
+    template<class F>
+    void parallel_(size_t count, F f) const{
+        std::atomic<size_t> next(0);
+        auto work = [&](){
+            for(size_t k=next++; k<count; k=next++) f(k);
+        };
+        std::vector<std::thread> threads;
+        for(size_t t=1; t<num_threads_ && t<count; ++t){
+            threads.emplace_back(work);
+        }
+        work();
+        for(auto& thread : threads) thread.join();
+    }
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "output.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+
+namespace{
+
+//keeps blocks from different threads' writers from interleaving
+std::mutex stream_mutex;
+
+void write_line(Writer& out, const std::vector<char>& cells){
+    for(char c : cells) out << c;
+}
+
+//"name":"cells", or "name":null if cells is empty
+void write_json_cells(Writer& out, const char* name,
+        const std::vector<char>& cells){
+    out << '"' << name << "\":";
+    if(cells.empty()) out << "null";
+    else{
+        out << '"';
+        write_line(out, cells);
+        out << '"';
+    }
+}
+
+//a solver's stats as a line, trailing columns or a member, by format
+void write_stats(Writer& out, Format format, const Stats& stats){
+    switch(format){
+        case Format::pretty:
+            out << "Guesses: " << stats.guesses << ", contradictions: "
+                << stats.contradictions << ", time: " << stats.micros
+                << "us\n";
+            break;
+        case Format::compact:
+            break;
+        case Format::csv:
+            out << ',' << stats.guesses << ',' << stats.contradictions << ','
+                << stats.micros;
+            break;
+        case Format::json:
+            out << ",\"stats\":{\"guesses\":" << stats.guesses
+                << ",\"contradictions\":" << stats.contradictions
+                << ",\"micros\":" << stats.micros << '}';
+            break;
+    }
+}
+
+}
+
+Format parse_format(const std::string& name){
+    if(name=="pretty") return Format::pretty;
+    if(name=="compact") return Format::compact;
+    if(name=="csv") return Format::csv;
+    if(name=="json") return Format::json;
+    throw(std::invalid_argument("Unknown format: " + name + "."));
+}
+
+/*
+ * Writer Functions
+ */
+
+void Writer::flush(){
+    std::lock_guard<std::mutex> lock(stream_mutex);
+    write_();
+    os_.flush();
+}
+
+Writer& Writer::spill_(){
+    if(buf_.size() >= capacity_){
+        std::lock_guard<std::mutex> lock(stream_mutex);
+        write_();
+    }
+    return *this;
+}
+
+void Writer::write_(){
+    os_.write(buf_.data(), buf_.size());
+    buf_.clear();
+}
+
+Writer& thread_writer(){
+    thread_local Writer writer(std::cout);
+    return writer;
+}
+
+/*
+ * Formatters
+ */
+
+void write_grid(Writer& out, const std::vector<char>& cells,
+        const Shape& shape){
+    size_t side_length = shape.side_length;
+    //horizontal bars span every cell, space and vertical bar
+    size_t num_bars = side_length/shape.box_width-1;
+    std::string bar(2*num_bars + 2*side_length - 1, '-');
+    bar.push_back('\n');
+    for(size_t r=0; r<side_length; ++r){
+        if(!(r%shape.box_height) && r!=0) out << bar;
+        for(size_t c=0; c<side_length; ++c){
+            if(!(c%shape.box_width) && c!=0) out << "| ";
+            out << cells[r*side_length + c];
+            out << (c!=side_length-1 ? ' ' : '\n');
+        }
+    }
+}
+
+void write_header(Writer& out, Format format, bool with_stats){
+    if(format!=Format::csv) return;
+    out << "puzzle,solution";
+    if(with_stats) out << ",guesses,contradictions,micros";
+    out << '\n';
+}
+
+void write_puzzle(Writer& out, Format format,
+        const std::vector<char>& puzzle, const Shape& shape){
+    if(format!=Format::pretty) return;
+    out << "Initial puzzle:\n";
+    write_grid(out, puzzle, shape);
+    out << '\n';
+}
+
+void write_solution(Writer& out, Format format,
+        const std::vector<char>& puzzle, const std::vector<char>& solution,
+        const Shape& shape, const Stats* stats){
+    switch(format){
+        case Format::pretty:
+            if(solution.empty()) out << "No solutions.\n";
+            else{
+                out << "Solved puzzle:\n";
+                write_grid(out, solution, shape);
+            }
+            if(stats) write_stats(out, format, *stats);
+            break;
+        case Format::compact:
+            //unsolvable puzzles are echoed unchanged, blanks and all
+            write_line(out, solution.empty() ? puzzle : solution);
+            out << '\n';
+            break;
+        case Format::csv:
+            write_line(out, puzzle);
+            out << ',';
+            write_line(out, solution);
+            if(stats) write_stats(out, format, *stats);
+            out << '\n';
+            break;
+        case Format::json:
+            out << '{';
+            write_json_cells(out, "puzzle", puzzle);
+            out << ',';
+            write_json_cells(out, "solution", solution);
+            if(stats) write_stats(out, format, *stats);
+            out << "}\n";
+            break;
+    }
+}
+
+void write_minimal_header(Writer& out, Format format){
+    if(format==Format::csv) out << "puzzle,minimal,clues\n";
+}
+
+void write_minimal(Writer& out, Format format,
+        const std::vector<char>& puzzle, const std::vector<char>& minimal,
+        const Shape& shape, size_t clues){
+    switch(format){
+        case Format::pretty:
+            if(minimal.empty()){
+                out << "Puzzle does not have a unique solution.\n";
+                break;
+            }
+            out << "Minimal puzzle (" << clues << " clues):\n";
+            write_grid(out, minimal, shape);
+            break;
+        case Format::compact:
+            write_line(out, minimal.empty() ? puzzle : minimal);
+            if(!minimal.empty()) out << ' ' << clues;
+            out << '\n';
+            break;
+        case Format::csv:
+            write_line(out, puzzle);
+            out << ',';
+            write_line(out, minimal);
+            out << ',';
+            if(!minimal.empty()) out << clues;
+            out << '\n';
+            break;
+        case Format::json:
+            out << '{';
+            write_json_cells(out, "puzzle", puzzle);
+            out << ',';
+            write_json_cells(out, "minimal", minimal);
+            if(!minimal.empty()) out << ",\"clues\":" << clues;
+            out << "}\n";
+            break;
+    }
+}
+
+void write_count_header(Writer& out, Format format, bool with_stats){
+    if(format!=Format::csv) return;
+    out << "puzzle,solutions";
+    if(with_stats) out << ",nodes,micros";
+    out << '\n';
+}
+
+void write_count(Writer& out, Format format, const std::vector<char>& puzzle,
+        std::uint64_t solutions, const Stats* stats){
+    switch(format){
+        case Format::pretty:
+            out << "Solutions: " << solutions << '\n';
+            if(stats){
+                out << "Nodes: " << stats->nodes << ", time: "
+                    << stats->micros << "us\n";
+            }
+            break;
+        case Format::compact:
+            write_line(out, puzzle);
+            out << ' ' << solutions << '\n';
+            break;
+        case Format::csv:
+            write_line(out, puzzle);
+            out << ',' << solutions;
+            if(stats) out << ',' << stats->nodes << ',' << stats->micros;
+            out << '\n';
+            break;
+        case Format::json:
+            out << '{';
+            write_json_cells(out, "puzzle", puzzle);
+            out << ",\"solutions\":" << solutions;
+            if(stats){
+                out << ",\"stats\":{\"nodes\":" << stats->nodes
+                    << ",\"micros\":" << stats->micros << '}';
+            }
+            out << "}\n";
+            break;
+    }
+}
+
+void write_edit_header(Writer& out, Format format, bool with_stats){
+    if(format!=Format::csv) return;
+    out << "row,col,value,puzzle,solution,solutions";
+    if(with_stats) out << ",guesses,contradictions,micros";
+    out << '\n';
+}
+
+void write_edit(Writer& out, Format format, size_t row, size_t col,
+        char val, const std::vector<char>& puzzle,
+        const std::vector<char>& solution, size_t solutions,
+        const Shape& shape, const Stats* stats){
+    const char* status = solutions==0 ? "none"
+        : solutions==1 ? "unique" : "multiple";
+    switch(format){
+        case Format::pretty:
+            if(val=='.') out << "Cleared ";
+            else out << "Set " << val << " at ";
+            out << '(' << row << ',' << col << "): ";
+            if(!solutions) out << "no solutions.\n";
+            else{
+                out << (solutions==1 ? "unique solution:\n"
+                        : "more than one solution, e.g.:\n");
+                write_grid(out, solution, shape);
+            }
+            if(stats) write_stats(out, format, *stats);
+            break;
+        case Format::compact:
+            write_line(out, solutions ? solution : puzzle);
+            out << ' ' << status << '\n';
+            break;
+        case Format::csv:
+            out << row << ',' << col << ',' << val << ',';
+            write_line(out, puzzle);
+            out << ',';
+            write_line(out, solution);
+            out << ',' << status;
+            if(stats) write_stats(out, format, *stats);
+            out << '\n';
+            break;
+        case Format::json:
+            out << "{\"row\":" << row << ",\"col\":" << col << ",\"value\":";
+            if(val=='.') out << "null";
+            else out << '"' << val << '"';
+            out << ',';
+            write_json_cells(out, "puzzle", puzzle);
+            out << ',';
+            write_json_cells(out, "solution", solution);
+            out << ",\"solutions\":\"" << status << '"';
+            if(stats) write_stats(out, format, *stats);
+            out << "}\n";
+            break;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef SUDOKU_OUTPUT
+#define SUDOKU_OUTPUT
+#include "corpus.hpp"
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+enum class Format{pretty, compact, csv, json};
+
+//throws std::invalid_argument for unknown format names
+Format parse_format(const std::string& name);
+
+struct Stats{
+    size_t guesses = 0;
+    size_t contradictions = 0;
+    size_t micros = 0;
+    size_t nodes = 0; //search nodes, for solution counts
+};
+
+/*
+ * Buffered writer. Text accumulates in memory and is handed to the stream
+ * in large blocks; the stream itself is only flushed by flush(), so
+ * callers decide where the flush points are (e.g. once per batch).
+ */
+class Writer{
+public:
+    Writer(std::ostream& os, size_t capacity=1<<16) :
+        os_(os), capacity_(capacity) {buf_.reserve(capacity);}
+    ~Writer() {flush();}
+    Writer& operator<<(char c){
+        buf_.push_back(c);
+        return spill_();
+    }
+    Writer& operator<<(const char* s){
+        buf_.append(s);
+        return spill_();
+    }
+    Writer& operator<<(const std::string& s){
+        buf_.append(s);
+        return spill_();
+    }
+    Writer& operator<<(size_t n){
+        buf_.append(std::to_string(n));
+        return spill_();
+    }
+    void flush();
+private:
+    std::ostream& os_;
+    size_t capacity_;
+    std::string buf_;
+    Writer& spill_();
+    void write_();
+};
+
+//this thread's writer for std::cout
+Writer& thread_writer();
+
+//grid with box separators
+void write_grid(Writer& out, const std::vector<char>& cells,
+        const Shape& shape);
+
+//column names, for formats that have them
+void write_header(Writer& out, Format format, bool with_stats);
+//anything that belongs before the solver's verbose trace
+void write_puzzle(Writer& out, Format format,
+        const std::vector<char>& puzzle, const Shape& shape);
+//solution is empty for unsolvable puzzles, stats is optional
+void write_solution(Writer& out, Format format,
+        const std::vector<char>& puzzle, const std::vector<char>& solution,
+        const Shape& shape, const Stats* stats=nullptr);
+
+//the same for fastsolve --minimize; minimal is empty for puzzles that
+//are not uniquely solvable
+void write_minimal_header(Writer& out, Format format);
+void write_minimal(Writer& out, Format format,
+        const std::vector<char>& puzzle, const std::vector<char>& minimal,
+        const Shape& shape, size_t clues);
+
+//the same for fastsolve --count
+void write_count_header(Writer& out, Format format, bool with_stats);
+void write_count(Writer& out, Format format, const std::vector<char>& puzzle,
+        std::uint64_t solutions, const Stats* stats=nullptr);
+
+//the same for fastsolve --edits, once per edit: val is '.' when the given
+//at (row,col) was removed, solutions is 0, 1, or 2 for more than one, and
+//solution is empty when there are none
+void write_edit_header(Writer& out, Format format, bool with_stats);
+void write_edit(Writer& out, Format format, size_t row, size_t col,
+        char val, const std::vector<char>& puzzle,
+        const std::vector<char>& solution, size_t solutions,
+        const Shape& shape, const Stats* stats=nullptr);
+
+#endif
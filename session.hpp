@@ -0,0 +1,366 @@
+#ifndef SUDOKU_SESSION
+#define SUDOKU_SESSION
+
+#include "fastgrid.hpp"
+#include "fastsolver.hpp"
+#include "output.hpp"
+#include <array>
+#include <deque>
+#include <utility>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+ * Puzzle that is edited one given at a time and re-solved after each edit.
+ *
+ * The candidates implied by the givens are kept between edits, so adding a
+ * given only clears its value from the cell's row, column and box, and
+ * removing one only puts the value back in those units where nothing else
+ * rules it out.
+ *
+ * So are the cells that the Solver's rules (a cell with one candidate, or
+ * a value with one place in a unit) fill in from the givens. They are
+ * propagated from a worklist of units: adding a given queues its row,
+ * column and box, and each cell filled in or candidate cleared queues its
+ * own units in turn, so only the part of the grid the edit reaches is
+ * looked at. A deduction can rest on any given, so a removal starts the
+ * worklist over from every unit of the remaining givens, and only when
+ * the deductions are next needed. A solver is only built when the rules
+ * leave cells empty, and it starts from where they stopped.
+ *
+ * The last result is also kept, along with the last puzzle that had a
+ * unique solution, and most edits are settled from them without a full
+ * search:
+ *  - adding a given that agrees with a unique solution keeps it unique, as
+ *    does getting back all the givens of the last unique puzzle (e.g. by
+ *    undoing a removal) with none that disagree with its solution,
+ *  - adding a given that disagrees with a unique solution leaves none,
+ *    since any solution of the new puzzle would also solve the old one,
+ *  - adding a given to a puzzle with no solution, or removing one from a
+ *    puzzle with several, changes nothing,
+ *  - removing a given from a uniquely solvable puzzle keeps the solution,
+ *    and any other one would have to differ at that cell, so the search
+ *    only looks for a solution with the old value ruled out there.
+ * Anything else (changing a given, or adding one to a puzzle with several
+ * solutions) is solved from scratch.
+ */
+template<size_t side_length, size_t box_height, size_t box_width>
+class Session{
+public:
+    typedef FastGrid<side_length, box_height, box_width> GridType;
+    typedef Solver<side_length, box_height, box_width> SolverType;
+    Session(const GridType& g, std::array<char, side_length> allowed_vals,
+            TranspositionTable* table=nullptr) :
+        puzzle_(g), solution_(g), unique_puzzle_(g), unique_solution_(g),
+        have_unique_(false), allowed_vals_(allowed_vals), table_(table),
+        deduced_{g, {}, 0, false}, stale_(true){
+        for(size_t r=0; r<side_length; ++r){
+            for(size_t c=0; c<side_length; ++c){
+                char val = puzzle_.at(r,c);
+                if(val!='.') check_val_(val);
+                possibilities_[r][c] = calculate_possibilities_(r,c);
+            }
+        }
+        resolve_();
+        remember_unique_();
+    }
+    //Sets the given at (r,c) to val, or removes it if val is '.', and
+    //re-solves the puzzle.
+    void set(size_t r, size_t c, char val){
+        if(r>=side_length || c>=side_length){
+            throw(std::invalid_argument("Cell (" + std::to_string(r) + ","
+                        + std::to_string(c) + ") is off the grid."));
+        }
+        if(val!='.') check_val_(val);
+        char old = puzzle_.at(r,c);
+        stats_ = Stats();
+        if(val==old) return;
+        if(old!='.') remove_given_(r, c, old);
+        if(val!='.') add_given_(r, c, val);
+        if(val!='.' && seen_(r, c, val)) solutions_ = 0; //clashing givens
+        else if(val=='.'){ //removal
+            if(solutions_==1) check_removal_(r, c, old);
+            else if(!solutions_) resolve_();
+        }
+        else if(old=='.'){ //addition
+            if(solutions_==2 && covers_unique_()){
+                solutions_ = 1;
+                solution_ = unique_solution_;
+            }
+            else if(solutions_==1 && solution_.at(r,c)!=val) solutions_ = 0;
+            else if(solutions_==2) solve_();
+        }
+        else resolve_(); //change
+        remember_unique_();
+    }
+    const GridType& puzzle() const{return puzzle_;}
+    //0 if the puzzle has no solution, 1 if it has exactly one, and 2 if it
+    //has more than one
+    size_t solutions() const{return solutions_;}
+    //a solution of the puzzle, if it has any
+    const GridType& solution() const{return solution_;}
+    //work done by the last edit
+    const Stats& stats() const{return stats_;}
+private:
+    GridType puzzle_;
+    GridType solution_;
+    GridType unique_puzzle_;
+    GridType unique_solution_;
+    bool have_unique_;
+    std::array<char, side_length> allowed_vals_;
+    TranspositionTable* table_;
+    typedef typename SolverType::PossibilityArray PossibilityArray;
+    //the givens plus the cells the rules fill in from them
+    struct Deductions{
+        GridType grid;
+        PossibilityArray possibilities;
+        size_t empty; //cells of grid still empty
+        bool dead; //the rules hit a contradiction
+    };
+    //units (rows, then columns, then boxes) waiting to be looked at
+    struct Worklist{
+        std::deque<size_t> units;
+        std::array<bool, 3*side_length> queued{};
+        void push(size_t unit){
+            if(queued[unit]) return;
+            queued[unit] = true;
+            units.push_back(unit);
+        }
+    };
+    PossibilityArray possibilities_;
+    Deductions deduced_;
+    bool stale_; //deduced_ needs rebuilding from the givens
+    size_t solutions_;
+    Stats stats_;
+    void check_val_(char val) const{
+        if(std::find(allowed_vals_.begin(), allowed_vals_.end(), val)
+                ==allowed_vals_.end()){
+            throw(std::invalid_argument(std::string("Invalid cell value: ")
+                        + val));
+        }
+    }
+    //calls f(r,c) on every cell sharing a row, column or box with (r,c),
+    //including (r,c) itself, possibly more than once
+    template<class F>
+    void for_peers_(size_t r, size_t c, F f) const{
+        size_t top = (r/box_height)*box_height;
+        size_t left = (c/box_width)*box_width;
+        for(size_t i=0; i<side_length; ++i){
+            f(r, i);
+            f(i, c);
+            f(top + i/box_width, left + i%box_width);
+        }
+    }
+    //whether val is a given in a row, column or box of (r,c), other than
+    //at (r,c)
+    bool seen_(size_t r, size_t c, char val) const{
+        bool seen = false;
+        for_peers_(r, c, [&](size_t pr, size_t pc){
+                if((pr!=r || pc!=c) && puzzle_.at(pr,pc)==val) seen = true;
+            });
+        return seen;
+    }
+    //whether the puzzle has every given of the last unique puzzle, and
+    //no given that disagrees with its solution
+    bool covers_unique_() const{
+        if(!have_unique_) return false;
+        auto puzzle = puzzle_.cells();
+        auto unique = unique_puzzle_.cells();
+        auto solution = unique_solution_.cells();
+        for(size_t i=0; i<puzzle.size(); ++i){
+            if(unique[i]!='.' && puzzle[i]!=unique[i]) return false;
+            if(puzzle[i]!='.' && puzzle[i]!=solution[i]) return false;
+        }
+        return true;
+    }
+    void remember_unique_(){
+        if(solutions_!=1) return;
+        unique_puzzle_ = puzzle_;
+        unique_solution_ = solution_;
+        have_unique_ = true;
+    }
+    CandidateSet calculate_possibilities_(size_t r, size_t c) const{
+        if(puzzle_.at(r,c)!='.') return {puzzle_.at(r,c)};
+        CandidateSet candidates;
+        for(char val : allowed_vals_){
+            if(!seen_(r, c, val)) candidates.insert(val);
+        }
+        return candidates;
+    }
+    void add_given_(size_t r, size_t c, char val){
+        puzzle_.set(r, c, val);
+        for_peers_(r, c, [&](size_t pr, size_t pc){
+                if(puzzle_.at(pr,pc)=='.') possibilities_[pr][pc].erase(val);
+            });
+        possibilities_[r][c] = {val};
+        if(stale_ || deduced_.dead) return;
+        Worklist work;
+        place_(deduced_, r, c, val, work);
+        propagate_(deduced_, work);
+    }
+    void remove_given_(size_t r, size_t c, char val){
+        puzzle_.set(r, c, '.');
+        for_peers_(r, c, [&](size_t pr, size_t pc){
+                if(puzzle_.at(pr,pc)=='.' && !seen_(pr, pc, val)){
+                    possibilities_[pr][pc].insert(val);
+                }
+            });
+        possibilities_[r][c] = calculate_possibilities_(r,c);
+        stale_ = true;
+    }
+    //cell i of a unit
+    std::pair<size_t, size_t> cell_(size_t unit, size_t i) const{
+        switch(unit/side_length){
+            case 0: return std::make_pair(unit, i);
+            case 1: return std::make_pair(i, unit - side_length);
+            default:
+                size_t b = unit - 2*side_length;
+                size_t boxes_per_row = side_length/box_width;
+                return std::make_pair((b/boxes_per_row)*box_height
+                        + i/box_width, (b%boxes_per_row)*box_width
+                        + i%box_width);
+        }
+    }
+    void push_units_(Worklist& work, size_t r, size_t c) const{
+        work.push(r);
+        work.push(side_length + c);
+        work.push(2*side_length + (r/box_height)*(side_length/box_width)
+                + c/box_width);
+    }
+    //Fills in (r,c) with val and clears val from its peers, queueing the
+    //units of every cell that changes.
+    void place_(Deductions& d, size_t r, size_t c, char val,
+            Worklist& work) const{
+        if(d.grid.at(r,c)!='.' || !d.possibilities[r][c].count(val)){
+            if(d.grid.at(r,c)!=val) d.dead = true;
+            return;
+        }
+        d.grid.set(r, c, val);
+        d.possibilities[r][c] = {val};
+        --d.empty;
+        push_units_(work, r, c);
+        for_peers_(r, c, [&](size_t pr, size_t pc){
+                if(d.grid.at(pr,pc)=='.'
+                        && d.possibilities[pr][pc].count(val)){
+                    d.possibilities[pr][pc].erase(val);
+                    push_units_(work, pr, pc);
+                }
+            });
+    }
+    //Applies the Solver's rules to the queued units until the worklist
+    //runs out or they hit a contradiction.
+    void propagate_(Deductions& d, Worklist& work) const{
+        while(!work.units.empty() && !d.dead){
+            size_t unit = work.units.front();
+            work.units.pop_front();
+            work.queued[unit] = false;
+            std::array<std::pair<size_t, size_t>, side_length> cells;
+            for(size_t i=0; i<side_length; ++i) cells[i] = cell_(unit, i);
+            for(const auto& cell : cells){
+                if(d.dead) break;
+                if(d.grid.at(cell.first, cell.second)!='.') continue;
+                const auto& candidates = d.possibilities[cell.first]
+                    [cell.second];
+                if(candidates.empty()) d.dead = true;
+                else if(candidates.size()==1){
+                    place_(d, cell.first, cell.second, *candidates.begin(),
+                            work);
+                }
+            }
+            //where each value can go in the unit, or side_length if it is
+            //already there
+            std::array<size_t, 'Z'-'0'+1> places{}, last{};
+            for(size_t i=0; i<side_length; ++i){
+                char filled = d.grid.at(cells[i].first, cells[i].second);
+                if(filled!='.'){
+                    places[filled-'0'] = side_length;
+                    continue;
+                }
+                for(char val : d.possibilities[cells[i].first]
+                        [cells[i].second]){
+                    if(places[val-'0']!=side_length) ++places[val-'0'];
+                    last[val-'0'] = i;
+                }
+            }
+            for(char val : allowed_vals_){
+                if(d.dead) break;
+                if(!places[val-'0']) d.dead = true;
+                else if(places[val-'0']==1){
+                    const auto& cell = cells[last[val-'0']];
+                    place_(d, cell.first, cell.second, val, work);
+                }
+            }
+        }
+    }
+    //the givens alone, with every unit queued
+    Deductions from_givens_(Worklist& work) const{
+        auto cells = puzzle_.cells();
+        for(size_t unit=0; unit<3*side_length; ++unit) work.push(unit);
+        return {puzzle_, possibilities_,
+            size_t(std::count(cells.begin(), cells.end(), '.')), false};
+    }
+    //brings deduced_ up to date after removals
+    void refresh_(){
+        if(!stale_) return;
+        Worklist work;
+        deduced_ = from_givens_(work);
+        propagate_(deduced_, work);
+        stale_ = false;
+    }
+    void add_stats_(const Stats& stats){
+        stats_.guesses += stats.guesses;
+        stats_.contradictions += stats.contradictions;
+    }
+    //Counts up to two solutions, searching only if the rules leave cells
+    //empty. The rules only fill in forced cells, so if they fill in all of
+    //them the solution is unique.
+    void solve_(){
+        refresh_();
+        if(deduced_.dead){
+            solutions_ = 0;
+            ++stats_.contradictions;
+        }
+        else if(!deduced_.empty){
+            solutions_ = 1;
+            solution_ = deduced_.grid;
+        }
+        else{
+            SolverType solver(deduced_.grid, allowed_vals_,
+                    deduced_.possibilities, false, table_);
+            solutions_ = solver.count_solutions(2, &solution_);
+            add_stats_(solver.stats());
+        }
+    }
+    //solve_(), for puzzles whose givens may clash
+    void resolve_(){
+        solutions_ = 0;
+        if(SolverType::conflicting(puzzle_)) return;
+        solve_();
+    }
+    //Whether a uniquely solvable puzzle still is after the given val at
+    //(r,c) was removed: any other solution differs from the known one
+    //there, so val is ruled out at (r,c) and one solution looked for. The
+    //deductions are worked out with val already ruled out, and deduced_
+    //is left to be rebuilt when next needed.
+    void check_removal_(size_t r, size_t c, char val){
+        Worklist work;
+        Deductions d = from_givens_(work);
+        d.possibilities[r][c].erase(val);
+        propagate_(d, work);
+        if(d.dead) ++stats_.contradictions;
+        else if(!d.empty) solutions_ = 2;
+        else{
+            //the solver records the elimination itself, so that its
+            //transposition table keys stay right
+            if(d.grid.at(r,c)=='.') d.possibilities[r][c].insert(val);
+            SolverType solver(d.grid, allowed_vals_, d.possibilities, false,
+                    table_);
+            solver.eliminate(r, c, val);
+            if(solver.count_solutions(1)) solutions_ = 2;
+            add_stats_(solver.stats());
+        }
+    }
+};
+
+#endif
@@ -1,16 +1,19 @@
 #include "puzzle.hpp"
 #include "parser.hpp"
+#include "output.hpp"
 #include <iostream>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <exception>
 
 using namespace std;
 
 void print(Grid g){
+    Writer& out = thread_writer();
     for(auto row : g.rows()){
-        for(auto element : row.elements()) cout << element << ' ';
-        cout << endl;
+        for(auto element : row.elements()) out << element << ' ';
+        out << '\n';
     }
 }
 
@@ -120,7 +123,7 @@ Grid solve(const Grid& g){
     if(next_gen!=g) return solve(next_gen);
     
     //finally, if you did not find any easy solutions, brute force
-    cout << "Brute forcing :(" << endl; //debug
+    thread_writer() << "Brute forcing :(\n"; //debug
     return brute_force(g);
 }
 
@@ -128,16 +131,19 @@ int main(int argc, char** argv){
     Parser p;
     std::vector<std::string> args(argv, argv+argc);
     Grid puzzle = p.parse(args);
-    cout << "Input: " << endl;
+    Writer& out = thread_writer();
+    out << "Input: \n";
     print(puzzle);
-    cout << endl; 
+    out << '\n'; 
     try{
         Grid solved_puzzle = solve(puzzle);
-        cout << "Solved puzzle: " << endl;
+        out << "Solved puzzle: \n";
         print(solved_puzzle);
+        out.flush();
     }
     catch(std::runtime_error e){
-        cout << e.what() << endl;
+        out << e.what() << '\n';
+        out.flush();
         exit(1);
     }
 }
@@ -0,0 +1,95 @@
+#ifndef SUDOKU_TRANSPOSITION
+#define SUDOKU_TRANSPOSITION
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+
+//which entry a store keeps when its slot is already taken
+enum class Replacement{
+    always,  //the new one
+    larger   //whichever proved the larger subtree dead
+};
+
+inline Replacement parse_replacement(const std::string& name){
+    if(name=="always") return Replacement::always;
+    if(name=="larger") return Replacement::larger;
+    throw(std::invalid_argument("Unknown replacement policy: " + name + "."));
+}
+
+/*
+ * Bounded table of Zobrist keys of search states already proven to have no
+ * solution, shared by any number of solver threads without locks. Each slot
+ * holds the node count of the dead subtree and that count XORed with the
+ * key; a torn read from a racing store fails the XOR check and is treated
+ * as a miss, so readers never see a key paired with someone else's entry.
+ */
+class TranspositionTable{
+public:
+    struct Counters{
+        std::uint64_t probes;
+        std::uint64_t hits;
+        std::uint64_t stores;
+        std::uint64_t nodes_saved;
+    };
+    TranspositionTable(size_t megabytes, Replacement policy=Replacement::larger)
+        : size_(1), policy_(policy){
+        if(megabytes > std::numeric_limits<size_t>::max() >> 20){
+            throw(std::invalid_argument("Transposition table too large."));
+        }
+        size_t max_entries = (megabytes << 20)/sizeof(Entry);
+        if(!max_entries){
+            throw(std::invalid_argument("Transposition table too small."));
+        }
+        while(2*size_ <= max_entries) size_ *= 2;
+        entries_.reset(new Entry[size_]);
+        for(size_t i=0; i<size_; ++i){
+            entries_[i].check.store(0, std::memory_order_relaxed);
+            entries_[i].nodes.store(0, std::memory_order_relaxed);
+        }
+    }
+    bool dead(std::uint64_t key){
+        probes_.fetch_add(1, std::memory_order_relaxed);
+        Entry& entry = entries_[key & (size_-1)];
+        auto nodes = entry.nodes.load(std::memory_order_relaxed);
+        auto check = entry.check.load(std::memory_order_relaxed);
+        if(!nodes || (check ^ nodes)!=key) return false;
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        nodes_saved_.fetch_add(nodes, std::memory_order_relaxed);
+        return true;
+    }
+    //nodes is the size of the subtree that was searched to prove key dead
+    void store(std::uint64_t key, std::uint64_t nodes){
+        if(!nodes) nodes = 1; //zero marks an empty slot
+        Entry& entry = entries_[key & (size_-1)];
+        if(policy_==Replacement::larger
+                && entry.nodes.load(std::memory_order_relaxed) > nodes){
+            return;
+        }
+        stores_.fetch_add(1, std::memory_order_relaxed);
+        entry.nodes.store(nodes, std::memory_order_relaxed);
+        entry.check.store(key ^ nodes, std::memory_order_relaxed);
+    }
+    Counters counters() const{
+        return {probes_.load(), hits_.load(), stores_.load(),
+            nodes_saved_.load()};
+    }
+    size_t size() const{return size_;}
+private:
+    struct Entry{
+        std::atomic<std::uint64_t> check;
+        std::atomic<std::uint64_t> nodes;
+    };
+    std::unique_ptr<Entry[]> entries_;
+    size_t size_;
+    Replacement policy_;
+    std::atomic<std::uint64_t> probes_{0};
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> stores_{0};
+    std::atomic<std::uint64_t> nodes_saved_{0};
+};
+
+#endif